@@ -0,0 +1,109 @@
+#include "../src/ScoreFile.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+// // Times score loading on every .json file of a directory and on synthetic scores of growing size.
+// // The streaming loader (ScoreFile::readFromDisk) is compared against the former DOM-based loader
+// // and against loading the same score from the binary format.
+// // Usage: benchmark <scoresDirectory> [synthetic sizes...]
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// // the loader ScoreFile used before the streaming one, kept here as reference
+int readWithDom(const char* path, std::vector<ScoreFile::Node>& nodes) {
+    std::ifstream f(path);
+    if (!f) return 1;
+    nlohmann::json data = nlohmann::json::parse(f);
+    nodes.clear();
+    nodes.reserve(data["score"].size());
+    for (int i = 0; i < data["score"].size(); ++i) {
+        nlohmann::json nodeData = data["score"][i];
+        nodes.emplace_back();
+        ScoreFile::Node& n = nodes.back();
+        n.id = nodeData["id"];
+        n.parentId = nodeData["parentId"];
+        n.ratioFromParent = discrete::Monzo((int)nodeData["ratioFromParent"][0]) / discrete::Monzo((int)nodeData["ratioFromParent"][1]);
+        n.positionInTaktsFromParent = nodeData["positionInTaktsFromParent"];
+        n.durationInTakts = nodeData["durationInTakts"];
+    }
+    return 0;
+}
+
+void makeSyntheticScore(ScoreFile& scoreFile, int nNodes, unsigned seed) {
+    static const int ratios[][2]{ {3,2}, {2,3}, {5,4}, {4,5}, {6,5}, {5,6}, {7,4}, {4,7}, {9,8}, {8,9}, {11,8}, {8,11} };
+    std::mt19937 rng(seed);
+    scoreFile.createBlank();
+    for (int i = 1; i < nNodes; ++i) {
+        // // prefer recent parents so that the tree gets deep, like real scores
+        int parentId = i - 1 - (int)(rng() % std::min(i, 16));
+        const int* r = ratios[rng() % std::size(ratios)];
+        scoreFile.createNode(parentId, discrete::Monzo(r[0]) / discrete::Monzo(r[1]), (int)(rng() % 5) - 1, 1 + (int)(rng() % 4));
+    }
+}
+
+void benchmarkLoad(const std::string& path) {
+    ScoreFile scoreFile;
+    auto t0 = std::chrono::steady_clock::now();
+    if (0 != scoreFile.readFromDisk(path.c_str())) {
+        std::cout << path << ": could not be read\n";
+        return;
+    }
+    double streamSeconds = secondsSince(t0);
+
+    std::vector<ScoreFile::Node> nodes;
+    t0 = std::chrono::steady_clock::now();
+    readWithDom(path.c_str(), nodes);
+    double domSeconds = secondsSince(t0);
+
+    std::string binaryPath = (std::filesystem::temp_directory_path() / ("juiedit_benchmark" + ScoreFile::binaryExtension)).string();
+    scoreFile.writeToDisk(binaryPath.c_str());
+    ScoreFile binaryScoreFile;
+    t0 = std::chrono::steady_clock::now();
+    binaryScoreFile.readFromDisk(binaryPath.c_str());
+    double binarySeconds = secondsSince(t0);
+    std::filesystem::remove(binaryPath);
+
+    std::cout << path << ": " << scoreFile.getNumberOfNodes() << " nodes, "
+        << "stream " << streamSeconds*1e3 << " ms, "
+        << "dom " << domSeconds*1e3 << " ms, "
+        << "binary " << binarySeconds*1e3 << " ms, "
+        << "speedup x" << domSeconds/streamSeconds << '\n';
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: benchmark <scoresDirectory> [synthetic sizes...]\n";
+        return 1;
+    }
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[1])) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths) benchmarkLoad(path);
+
+    std::vector<int> sizes;
+    for (int i = 2; i < argc; ++i) sizes.push_back(std::stoi(argv[i]));
+    if (sizes.empty()) sizes = {1000, 10000, 100000, 1000000};
+    for (int n : sizes) {
+        ScoreFile scoreFile;
+        makeSyntheticScore(scoreFile, n, 1234);
+        std::string path = (std::filesystem::temp_directory_path() / ("juiedit_synthetic_" + std::to_string(n) + ".json")).string();
+        if (0 != scoreFile.writeToDisk(path.c_str())) {
+            std::cout << path << ": could not be written\n";
+            continue;
+        }
+        benchmarkLoad(path);
+        std::filesystem::remove(path);
+    }
+    return 0;
+}
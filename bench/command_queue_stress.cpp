@@ -0,0 +1,77 @@
+#include "../src/ScorePlayer.hpp"
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <random>
+
+// // Stress test of the command queue, through the functions the UI uses: several producer threads (the editor has two,
+// // main and console) send transport commands as fast as they can, while a consumer thread drains the queue the way
+// // the audio callback does, in bursts with pauses between them, so the queue keeps filling up and the producers
+// // keep waiting for room. Every command carries its producer and a sequence number; the consumer checks that
+// // none is lost, repeated, reordered within its producer, or torn (its fields written by two sends).
+// // No audio device is opened. Returns 0 if every check passed.
+// // Usage: command_queue_stress [commands per producer, 1000000 by default] [producers, 2 by default]
+
+using namespace ScorePlayer;
+
+int main(int argc, char** argv) {
+    const long long nCommands = argc > 1 ? std::stoll(argv[1]) : 1000000;
+    const int nProducers = argc > 2 ? std::stoi(argv[2]) : 2;
+    
+    std::atomic<int> nProducersDone{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < nProducers; ++p) {
+        producers.emplace_back([&, p]() {
+            for (long long k = 0; k < nCommands; ++k) {
+                // // the loop flag and the sign of the second number are redundant with the first two, to detect tearing
+                sendTransportCommand(Command::Type::TransportSeek, p*1e12 + k, -(p*1e12 + k), p % 2 == 1);
+            }
+            ++nProducersDone;
+        });
+    }
+    
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<long long> nextSequence(nProducers, 0);
+    long long nReceived = 0, nErrors = 0;
+    std::mt19937 rng(1234);
+    while (true) {
+        const bool areProducersDone = nProducersDone.load() == nProducers; // // read before draining: nothing may arrive later
+        int burst = 1 + (int)(rng() % 96);
+        while (burst-- > 0) {
+            const Command* command = commands.front();
+            if (!command) break;
+            const long long value = (long long)command->takts[0];
+            const int p = (int)(value / 1000000000000LL);
+            const long long k = value % 1000000000000LL;
+            if (command->type != Command::Type::TransportSeek || p < 0 || p >= nProducers ||
+                command->takts[1] != -command->takts[0] || command->isLooping != (p % 2 == 1)) {
+                ++nErrors;
+            }
+            else if (k != nextSequence[p]) {
+                if (nErrors < 10) std::cerr << "producer " << p << ": expected command " << nextSequence[p] << ", got " << k << '\n';
+                ++nErrors;
+                nextSequence[p] = k + 1;
+            }
+            else {
+                ++nextSequence[p];
+            }
+            ++nReceived;
+            commands.pop();
+        }
+        if (areProducersDone && !commands.front()) break;
+        if (rng() % 4 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50)); // // between audio blocks
+    }
+    for (auto& producer : producers) producer.join();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    
+    for (int p = 0; p < nProducers; ++p) {
+        if (nextSequence[p] != nCommands) {
+            std::cerr << "producer " << p << ": " << nextSequence[p] << " of " << nCommands << " commands received\n";
+            ++nErrors;
+        }
+    }
+    std::cout << nReceived << " commands from " << nProducers << " producers in " << seconds << " s, " << nErrors << " errors\n";
+    return nErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "../src/ScoreFile.hpp"
+#include "../src/SmallMonzo.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+
+// // Compares SmallMonzo against discrete::Monzo on the ratios of every .json score of a directory, on the
+// // operations ScoreFile and ScoreEditor do most: the absolute ratio of every node (a product per node, parents first),
+// // and the ratio between random pairs of nodes with its log2 (a quotient and a logarithm per pair).
+// // Each case is repeated until it takes a noticeable time; costs are reported in nanoseconds per operation.
+// // Also counts the ratios that fell back to discrete::Monzo and checks that both types agree.
+// // Usage: monzo_benchmark <scoresDirectory> [pairs per score, 100000 by default]
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+volatile double sink; // // keeps the logarithms from being optimized away
+
+// // calls f until a tenth of a second has passed, and returns the seconds per call
+template <typename F>
+double timePerCall(F f) {
+    int nCalls = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    do {
+        f();
+        ++nCalls;
+    } while (secondsSince(t0) < 0.1);
+    return secondsSince(t0) / nCalls;
+}
+
+void benchmarkScore(const std::string& path, int nPairs) {
+    ScoreFile scoreFile;
+    if (0 != scoreFile.readFromDisk(path.c_str())) {
+        std::cout << path << ": could not be read\n";
+        return;
+    }
+    // // the tree in arrays, parents before children, as positions in those arrays
+    const std::vector<int> ids = scoreFile.getOrderedNodeIds();
+    const int nNodes = ids.size();
+    std::vector<int> positions(scoreFile.getNumberOfSlots(), -1);
+    for (int k = 0; k < nNodes; ++k) positions[ids[k]] = k;
+    std::vector<int> parents(nNodes, -1);
+    std::vector<discrete::Monzo> ratios(nNodes, discrete::Monzo(1));
+    std::vector<SmallMonzo> smallRatios(nNodes);
+    std::vector<char> isSmall(nNodes, 1);
+    for (int k = 1; k < nNodes; ++k) {
+        parents[k] = positions[scoreFile.getParentId(ids[k])];
+        ratios[k] = scoreFile.getRatioFromParent(ids[k]);
+        isSmall[k] = 0 == SmallMonzo::fromMonzo(ratios[k], smallRatios[k]);
+    }
+
+    std::vector<discrete::Monzo> absoluteRatios(nNodes, discrete::Monzo(1));
+    const double monzoProduct = timePerCall([&]() {
+        for (int k = 1; k < nNodes; ++k) absoluteRatios[k] = absoluteRatios[parents[k]] * ratios[k];
+    }) / nNodes;
+    std::vector<SmallMonzo> absoluteSmallRatios(nNodes);
+    std::vector<char> isAbsoluteSmall(nNodes, 1);
+    const double smallProduct = timePerCall([&]() {
+        for (int k = 1; k < nNodes; ++k) {
+            isAbsoluteSmall[k] = isSmall[k] && isAbsoluteSmall[parents[k]] && 
+                0 == SmallMonzo::multiply(absoluteSmallRatios[parents[k]], smallRatios[k], absoluteSmallRatios[k]);
+        }
+    }) / nNodes;
+    int nFallbacks = 0, nMismatches = 0;
+    for (int k = 0; k < nNodes; ++k) {
+        if (!isAbsoluteSmall[k]) ++nFallbacks;
+        else if (!(absoluteSmallRatios[k].toMonzo() == absoluteRatios[k])) ++nMismatches;
+    }
+
+    std::mt19937 rng(1234);
+    std::vector<int> pairs(2*nPairs);
+    for (int& k : pairs) k = rng() % nNodes;
+    double sum = 0;
+    const double monzoQuotient = timePerCall([&]() {
+        for (int i = 0; i < nPairs; ++i) sum += std::log2((double)(absoluteRatios[pairs[2*i+1]] / absoluteRatios[pairs[2*i]]));
+    }) / nPairs;
+    const double smallQuotient = timePerCall([&]() {
+        SmallMonzo ratio;
+        for (int i = 0; i < nPairs; ++i) {
+            if (0 == SmallMonzo::divide(absoluteSmallRatios[pairs[2*i+1]], absoluteSmallRatios[pairs[2*i]], ratio)) sum += ratio.log2();
+        }
+    }) / nPairs;
+    for (int i = 0; i < nPairs; ++i) {
+        SmallMonzo ratio;
+        const int from = pairs[2*i], to = pairs[2*i+1];
+        if (!isAbsoluteSmall[from] || !isAbsoluteSmall[to] || 0 != SmallMonzo::divide(absoluteSmallRatios[to], absoluteSmallRatios[from], ratio)) continue;
+        if (std::abs(ratio.log2() - std::log2((double)(absoluteRatios[to] / absoluteRatios[from]))) > 1e-9) ++nMismatches;
+    }
+
+    std::cout << path << ": " << nNodes << " nodes, "
+        << "product " << monzoProduct*1e9 << " ns vs " << smallProduct*1e9 << " ns (x" << monzoProduct/smallProduct << "), "
+        << "quotient+log2 " << monzoQuotient*1e9 << " ns vs " << smallQuotient*1e9 << " ns (x" << monzoQuotient/smallQuotient << "), "
+        << nFallbacks << " fallbacks, " << nMismatches << " mismatches\n";
+    sink = sum;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: monzo_benchmark <scoresDirectory> [pairs per score]\n";
+        return 1;
+    }
+    const int nPairs = argc > 2 ? std::stoi(argv[2]) : 100000;
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[1])) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths) benchmarkScore(path, nPairs);
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "../src/ScoreFile.hpp"
+#include "../src/RatioMenus.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <filesystem>
+#include <algorithm>
+
+// // Benchmark suite of the headless core: links libjuiedit_core (ScoreFile and RatioMenus), no window, no SDL.
+// // Times the operations of the score model on every .json score of a directory and on synthetic scores of growing
+// // size: load and save in both formats, getOrderedNodeIds, getFrequency over all nodes (right after loading, which
+// // fills the cache of absolute ratios, and again), changeRoot, deleteNode, bulk createNode; and the ratio menus.
+// // Prints one CSV row per measurement, for scripts: score,nodes,operation,count,seconds,nanoseconds_per_item.
+// // Usage: score_benchmark <scoresDirectory> [synthetic sizes...]
+
+volatile double sink; // // keeps the frequencies from being optimized away
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void printRow(const std::string& score, int nNodes, const char* operation, long long count, double seconds) {
+    std::cout << '"' << score << "\"," << nNodes << ',' << operation << ',' << count << ',' << seconds << ',' << (count > 0 ? seconds / count * 1e9 : 0.0) << std::endl; // // flushed: big scores take a while
+}
+
+// // like benchmark.cpp's, a deep tree of small ratios with notes around their parents
+void makeSyntheticScore(ScoreFile& scoreFile, int nNodes, unsigned seed) {
+    static const int ratios[][2]{ {3,2}, {2,3}, {5,4}, {4,5}, {6,5}, {5,6}, {7,4}, {4,7}, {9,8}, {8,9}, {11,8}, {8,11} };
+    std::mt19937 rng(seed);
+    scoreFile.createBlank();
+    for (int i = 1; i < nNodes; ++i) {
+        int parentId = i - 1 - (int)(rng() % std::min(i, 16));
+        const int* r = ratios[rng() % std::size(ratios)];
+        scoreFile.createNode(parentId, discrete::Monzo(r[0]) / discrete::Monzo(r[1]), (int)(rng() % 5) - 1, 1 + (int)(rng() % 4));
+    }
+}
+
+void benchmarkFrequencies(const std::string& name, const ScoreFile& scoreFile, const char* operation) {
+    const std::vector<int> ids = scoreFile.getOrderedNodeIds();
+    double sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int id : ids) sum += scoreFile.getFrequency(id);
+    printRow(name, scoreFile.getNumberOfNodes(), operation, ids.size(), secondsSince(t0));
+    sink = sum;
+}
+
+// // the editing operations, on a copy of the score since they change it
+void benchmarkEdits(const std::string& name, const ScoreFile& original) {
+    const int nNodes = original.getNumberOfNodes();
+    ScoreFile scoreFile = original;
+    const std::vector<int> ids = scoreFile.getOrderedNodeIds();
+
+    // // to a node at the bottom of the tree and back, each followed by the frequencies, which changeRoot invalidates
+    const int nRootChanges = 10;
+    const int oldRootId = scoreFile.getRootId(), newRootId = ids.back();
+    double rootSeconds = 0;
+    for (int k = 0; k < nRootChanges; ++k) {
+        auto t0 = std::chrono::steady_clock::now();
+        scoreFile.changeRoot(k % 2 ? oldRootId : newRootId);
+        rootSeconds += secondsSince(t0);
+        sink = scoreFile.getFrequency(ids[ids.size()/2]);
+    }
+    printRow(name, nNodes, "changeRoot", nRootChanges, rootSeconds);
+
+    // // half of the nodes at random, whose children move to their parent
+    std::mt19937 rng(1234);
+    std::vector<int> deletedIds(ids.begin() + 1, ids.end());
+    std::shuffle(deletedIds.begin(), deletedIds.end(), rng);
+    deletedIds.resize(deletedIds.size() / 2);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int id : deletedIds) scoreFile.deleteNode(id);
+    printRow(name, nNodes, "deleteNode", deletedIds.size(), secondsSince(t0));
+
+    // // as many new nodes as the score had, under random live nodes
+    const std::vector<int> parentIds = scoreFile.getOrderedNodeIds();
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < nNodes; ++i) {
+        scoreFile.createNode(parentIds[rng() % parentIds.size()], discrete::Monzo(3) / discrete::Monzo(2), (int)(rng() % 5) - 1, 1);
+    }
+    printRow(name, nNodes, "createNode", nNodes, secondsSince(t0));
+}
+
+void benchmarkScore(const std::string& name, const ScoreFile& scoreFile) {
+    const int nNodes = scoreFile.getNumberOfNodes();
+    for (const std::string& extension : {std::string(".json"), ScoreFile::binaryExtension}) {
+        const bool isBinary = extension == ScoreFile::binaryExtension;
+        std::string path = (std::filesystem::temp_directory_path() / ("juiedit_score_benchmark" + extension)).string();
+        auto t0 = std::chrono::steady_clock::now();
+        if (0 != scoreFile.writeToDisk(path.c_str())) {
+            std::cerr << path << ": could not be written\n";
+            continue;
+        }
+        printRow(name, nNodes, isBinary ? "save_binary" : "save_json", nNodes, secondsSince(t0));
+        ScoreFile loaded;
+        t0 = std::chrono::steady_clock::now();
+        if (0 != loaded.readFromDisk(path.c_str())) {
+            std::cerr << path << ": could not be read\n";
+            continue;
+        }
+        printRow(name, nNodes, isBinary ? "load_binary" : "load_json", nNodes, secondsSince(t0));
+        std::filesystem::remove(path);
+        if (isBinary) continue;
+
+        t0 = std::chrono::steady_clock::now();
+        const std::vector<int> ids = loaded.getOrderedNodeIds();
+        printRow(name, nNodes, "getOrderedNodeIds", ids.size(), secondsSince(t0));
+        benchmarkFrequencies(name, loaded, "getFrequency_cold");
+        benchmarkFrequencies(name, loaded, "getFrequency_warm");
+        benchmarkEdits(name, loaded);
+    }
+}
+
+void benchmarkRatioMenus() {
+    for (int limit : {23, 100}) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::shared_ptr<RatioMenus> ratioMenus = RatioMenus::get(limit);
+        printRow("limit " + std::to_string(limit), 0, "RatioMenus_get_cold", 1, secondsSince(t0));
+        t0 = std::chrono::steady_clock::now();
+        RatioMenus::get(limit);
+        printRow("limit " + std::to_string(limit), 0, "RatioMenus_get_warm", 1, secondsSince(t0));
+        t0 = std::chrono::steady_clock::now();
+        for (int st = -36; st <= 36; ++st) ratioMenus->getCollection(st);
+        printRow("limit " + std::to_string(limit), 0, "getCollection", 73, secondsSince(t0));
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: score_benchmark <scoresDirectory> [synthetic sizes...]\n";
+        return 1;
+    }
+    std::cout << "score,nodes,operation,count,seconds,nanoseconds_per_item\n";
+
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(argv[1])) {
+        if (entry.is_regular_file() && entry.path().extension() == ".json") paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    for (const auto& path : paths) {
+        ScoreFile scoreFile;
+        if (0 != scoreFile.readFromDisk(path.c_str())) {
+            std::cerr << path << ": could not be read\n";
+            continue;
+        }
+        benchmarkScore(path, scoreFile);
+    }
+
+    std::vector<int> sizes;
+    for (int i = 2; i < argc; ++i) sizes.push_back(std::stoi(argv[i]));
+    if (sizes.empty()) sizes = {1000, 10000, 100000, 1000000};
+    for (int n : sizes) {
+        ScoreFile scoreFile;
+        auto t0 = std::chrono::steady_clock::now();
+        makeSyntheticScore(scoreFile, n, 1234);
+        const std::string name = "synthetic " + std::to_string(n);
+        printRow(name, n, "createNode_bulk", n-1, secondsSince(t0));
+        benchmarkScore(name, scoreFile);
+    }
+
+    benchmarkRatioMenus();
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "../src/ScorePlayer.hpp"
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+// // Measures the cost of ScoreSynth::Render for growing numbers of voices, with each oscillator engine.
+// // Each case renders the same audio in device-sized periods and one frame at a time, which is what the
+// // per-sample synth used to cost. Costs are reported per second of audio, in total and per voice.
+// // Then, for each engine, the voices one core can play within a share of its time (the CPU budget),
+// // extrapolated from the cost per voice with the most voices.
+// // Usage: synth_benchmark [seconds of audio per case] [CPU budget, 0.5 by default]
+
+using namespace ScorePlayer;
+
+double renderSeconds(int framesPerCall, double audioSeconds) {
+    const int periodSize = (int)(audioSettings.sampleRate * audioSettings.periodSizeInMilliseconds / 1000);
+    std::vector<float> out(2*periodSize);
+    const long long nFrames = (long long)(audioSeconds * audioSettings.sampleRate);
+    auto t0 = std::chrono::steady_clock::now();
+    for (long long done = 0; done < nFrames; done += periodSize) {
+        for (int i = 0; i < periodSize; i += framesPerCall) {
+            synth.Render(out.data() + 2*i, std::min(framesPerCall, periodSize - i));
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char** argv) {
+    const double audioSeconds = argc > 1 ? std::stod(argv[1]) : 20.0;
+    const double cpuBudget = argc > 2 ? std::stod(argv[2]) : 0.5;
+    synth.Start(64, audioSettings.sampleRate);
+    const int nEngines = (int)OscillatorEngine::nEngines;
+    std::vector<double> costPerVoice(nEngines);
+    std::cout << "engine, voices, block ms/s, per-sample ms/s, block ms/s/voice, per-sample ms/s/voice, block realtime factor\n";
+    for (int engine = 0; engine < nEngines; ++engine) {
+        setOscillator((OscillatorEngine)engine, WavetableBank::Timbre::Saw);
+        for (int nVoices : {1, 2, 4, 8, 16, 32, 64}) {
+            stop(); // // the voices restart with the engine of this case
+            synth.processCommands(commands);
+            renderSeconds(ScoreSynth::maxBlockSize, 0.1);
+            std::vector<double> freqs;
+            for (int v = 0; v < nVoices; ++v) freqs.push_back(110. * (1 + v));
+            playFrequencies(freqs);
+            synth.processCommands(commands);
+            renderSeconds(ScoreSynth::maxBlockSize, 0.5); // // past the fade-in
+            
+            double blockSeconds = renderSeconds(ScoreSynth::maxBlockSize, audioSeconds);
+            double sampleSeconds = renderSeconds(1, audioSeconds);
+            double blockCost = 1e3 * blockSeconds / audioSeconds;
+            double sampleCost = 1e3 * sampleSeconds / audioSeconds;
+            std::cout << oscillatorEngineNames[engine] << ", " << nVoices << ", " << blockCost << ", " << sampleCost << ", "
+                << blockCost / nVoices << ", " << sampleCost / nVoices << ", "
+                << audioSeconds / blockSeconds << '\n';
+            costPerVoice[engine] = blockSeconds / audioSeconds / nVoices;
+        }
+    }
+    std::cout << "\nengine, voices per core at " << 100*cpuBudget << "% CPU\n";
+    for (int engine = 0; engine < nEngines; ++engine) {
+        std::cout << oscillatorEngineNames[engine] << ", " << (int)(cpuBudget / costPerVoice[engine]) << '\n';
+    }
+    return 0;
+}
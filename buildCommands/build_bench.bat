@@ -0,0 +1,8 @@
+g++ -std=c++2a -m64 -O2 "bench/benchmark.cpp" "src/ScoreFile.cpp" -o _builds/benchmark.exe
+@echo off
+if %errorlevel%==0 (
+    "_builds/benchmark.exe" demos
+) else (
+    echo "COMPILATION FAILED"
+)
+@echo on
@@ -0,0 +1,11 @@
+#!/bin/sh
+# // Linux build of the headless core (ScoreFile and RatioMenus, without SDL) as a static library, and of the
+# // benchmark suite that links it. Runs the suite on demos, passing on the arguments (synthetic score sizes).
+# // The CSV goes to _builds/score_benchmark.csv as well as to the terminal
+set -e
+mkdir -p _builds/core
+g++ -std=c++2a -m64 -O2 -c "src/ScoreFile.cpp" -o _builds/core/ScoreFile.o
+g++ -std=c++2a -m64 -O2 -c "src/RatioMenus.cpp" -o _builds/core/RatioMenus.o
+ar rcs _builds/libjuiedit_core.a _builds/core/ScoreFile.o _builds/core/RatioMenus.o
+g++ -std=c++2a -m64 -O2 "bench/score_benchmark.cpp" -L_builds -ljuiedit_core -o _builds/score_benchmark
+_builds/score_benchmark demos "$@" | tee _builds/score_benchmark.csv
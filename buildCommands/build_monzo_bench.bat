@@ -0,0 +1,8 @@
+g++ -std=c++2a -m64 -O2 "bench/monzo_benchmark.cpp" "src/ScoreFile.cpp" -o _builds/monzo_benchmark.exe
+@echo off
+if %errorlevel%==0 (
+    "_builds/monzo_benchmark.exe" demos
+) else (
+    echo "COMPILATION FAILED"
+)
+@echo on
@@ -0,0 +1,8 @@
+g++ -std=c++2a -m64 -O2 "bench/command_queue_stress.cpp" -o _builds/command_queue_stress.exe
+@echo off
+if %errorlevel%==0 (
+    "_builds/command_queue_stress.exe"
+) else (
+    echo "COMPILATION FAILED"
+)
+@echo on
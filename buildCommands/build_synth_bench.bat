@@ -0,0 +1,8 @@
+g++ -std=c++2a -m64 -O2 "bench/synth_benchmark.cpp" -o _builds/synth_benchmark.exe
+@echo off
+if %errorlevel%==0 (
+    "_builds/synth_benchmark.exe"
+) else (
+    echo "COMPILATION FAILED"
+)
+@echo on
@@ -0,0 +1,110 @@
+#include "RatioMenus.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+std::shared_ptr<RatioMenus> RatioMenus::get(int limit) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::shared_ptr<RatioMenus>& entry = cache[limit];
+    if (!entry) {
+        entry = std::make_shared<RatioMenus>();
+        entry->limit = limit;
+        entry->baseCollections = calculatePossibleRatios(limit);
+    }
+    return entry;
+}
+
+// // the collection of semitonesFromParent is that of semitonesFromParent mod 12 moved by whole octaves; below the
+// // parent, it is that of the opposite distance with every ratio inverted, which reverses their order
+const RatioMenus::Collection& RatioMenus::getCollection(int semitonesFromParent) {
+    if (0 <= semitonesFromParent && semitonesFromParent < 12) return baseCollections[semitonesFromParent];
+    auto it = foldedCollections.find(semitonesFromParent);
+    if (it != foldedCollections.end()) return it->second;
+    
+    int baseId = semitonesFromParent;
+    discrete::Monzo octaveCompensation(1);
+    while (baseId <= -12) {
+        baseId += 12;
+        octaveCompensation /= discrete::Monzo(2);
+    }
+    while (baseId >= 12) {
+        baseId -= 12;
+        octaveCompensation *= discrete::Monzo(2);
+    }
+    const bool isInverted = baseId < 0;
+    if (isInverted) baseId = -baseId;
+    const Collection& base = baseCollections[baseId];
+    
+    Collection& collection = foldedCollections[semitonesFromParent];
+    const int n = base.ratios.size();
+    for (int i = 0; i < n; ++i) {
+        const int k = isInverted ? n-1-i : i;
+        discrete::Monzo ratio = (isInverted ? discrete::Monzo(1)/base.ratios[k] : base.ratios[k]) * octaveCompensation;
+        collection.labels.push_back(std::to_string((int)ratio.numerator())+":"+std::to_string((int)ratio.denominator()));
+        collection.ratios.push_back(ratio);
+    }
+    collection.centerItemId = isInverted ? n-1 - base.centerItemId : base.centerItemId;
+    return collection;
+}
+
+// // The ratios n/d with d < n <= N and n < 2d, by the semitones they round to. Fractions are reduced and sorted as
+// // pairs of integers, so discrete::Monzo is only built once for each distinct ratio
+std::vector<RatioMenus::Collection> RatioMenus::calculatePossibleRatios(const int N) {
+    std::vector<std::pair<int, int>> fractions;
+    for (int n = 3; n <= N; ++n) {
+        for (int d = n/2+1; d <= n; ++d) {
+            const int g = std::gcd(n, d);
+            fractions.push_back({n/g, d/g});
+        }
+    }
+    auto isLess = [](const std::pair<int, int>& a, const std::pair<int, int>& b) { 
+        return (long long)a.first*b.second < (long long)b.first*a.second; 
+    };
+    std::sort(fractions.begin(), fractions.end(), isLess);
+    fractions.erase(std::unique(fractions.begin(), fractions.end()), fractions.end());
+    
+    std::vector<Collection> menuCollections;
+    menuCollections.resize(12);
+    std::vector<std::pair<int, int>> collectionFractions[12];
+    int nUnfolded = -1; // // ratios of the unison collection that are not below 1
+    for (auto [n, d] : fractions) {
+        int stRound = (int)std::round(12. * std::log2((double)n / d));
+        if (stRound == 12) { // // a bit less than an octave goes with the unison, as a bit less than 1
+            if (nUnfolded == -1) nUnfolded = collectionFractions[0].size();
+            stRound = 0;
+            if (n % 2 == 0) n /= 2;
+            else d *= 2;
+        }
+        menuCollections[stRound].ratios.push_back(discrete::Monzo(n) / discrete::Monzo(d));
+        menuCollections[stRound].labels.push_back(std::to_string(n)+":"+std::to_string(d));
+        collectionFractions[stRound].push_back({n, d});
+    }
+    // // the ratios below 1 came last, already in order: they go first
+    if (nUnfolded != -1) {
+        Collection& c = menuCollections[0];
+        std::rotate(c.ratios.begin(), c.ratios.begin() + nUnfolded, c.ratios.end());
+        std::rotate(c.labels.begin(), c.labels.begin() + nUnfolded, c.labels.end());
+        std::rotate(collectionFractions[0].begin(), collectionFractions[0].begin() + nUnfolded, collectionFractions[0].end());
+    }
+    
+    // // the menus open on these ratios; if the limit leaves one out, on the simplest ratio of its collection
+    static const std::pair<int, int> centers[12]{
+        {1, 1}, {16, 15}, {9, 8}, {6, 5}, {5, 4}, {4, 3}, {10, 7}, {3, 2}, {8, 5}, {5, 3}, {9, 5}, {15, 8}
+    };
+    for (int i = 0; i < 12; ++i) {
+        const auto& v = collectionFractions[i];
+        auto it = std::lower_bound(v.begin(), v.end(), centers[i], isLess);
+        if (it != v.end() && *it == centers[i]) {
+            menuCollections[i].centerItemId = std::distance(v.begin(), it);
+            continue;
+        }
+        menuCollections[i].centerItemId = 0;
+        for (int k = 1; k < v.size(); ++k) {
+            const auto& best = v[menuCollections[i].centerItemId];
+            if ((long long)v[k].first*v[k].second < (long long)best.first*best.second) menuCollections[i].centerItemId = k;
+        }
+    }
+    
+    return menuCollections;
+}
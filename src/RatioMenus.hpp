@@ -0,0 +1,36 @@
+#ifndef RATIO_MENUS_H
+#define RATIO_MENUS_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "../external/discrete/primes.hpp"
+
+// // All the ratio menus of one limit, the greatest numerator or denominator of their ratios. The collections of
+// // [0, 12) semitones are computed with the entry; the others, octave-folded and inverted from those, the first time
+// // a menu asks for them (only the UI thread does). No SDL here: this is part of the headless core, with ScoreFile
+struct RatioMenus {
+    // // the items of the ratio menu opened at some distance in semitones from the parent, from the lowest ratio up
+    struct Collection {
+        std::vector<discrete::Monzo> ratios;
+        std::vector<std::string> labels;
+        int centerItemId;
+    };
+    int limit;
+    std::vector<Collection> baseCollections;
+    std::map<int, Collection> foldedCollections;
+    const Collection& getCollection(int semitonesFromParent);
+    
+    // // Entries are built on first use and kept, so going back to a limit costs nothing
+    static std::shared_ptr<RatioMenus> get(int limit);
+    static std::vector<Collection> calculatePossibleRatios(const int N);
+    
+private:
+    inline static std::mutex cacheMutex;
+    inline static std::map<int, std::shared_ptr<RatioMenus>> cache;
+};
+
+#endif /* end of include guard: RATIO_MENUS_H */
@@ -1,10 +1,12 @@
 #include "ScoreEditor.hpp"
 #include "utilities.hpp"
 
-#include <set>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
 
 ScoreEditor::ScoreEditor(ScoreFile& _scoreFile) : scoreFile{_scoreFile} {
-    menuCollections = calculatePossibleRatios(23);
+    ratioMenus = RatioMenus::get(23);
 }
 ScoreEditor::~ScoreEditor() {}
 
@@ -37,6 +39,8 @@ int ScoreEditor::init(std::string windowTitle) {
 		return -1;
 	}
 
+    wakeEventType = SDL_RegisterEvents(1);
+    
     if (0 != TTF_Init()) return -777;
     
     font = TTF_OpenFont("C:/terminal_graphics/jui_editor/data/fonts/arial.ttf", 20);
@@ -50,16 +54,35 @@ int ScoreEditor::init(std::string windowTitle) {
 }
 
 int ScoreEditor::uninit() {
+    std::cout << ">> text cache: " << textCache.getHits() << " hits, " << textCache.getMisses() << " misses, hit rate "
+        << roundint((float)(100.0*textCache.getHitRate())) << "%\n";
+    textCache.clear(); // // its textures belong to the renderer
+    wakeEventType = (Uint32)-1; // // later wakes, from threads still winding down, are dropped
     SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
 	SDL_Quit();
     return 0;
 }
 
+void ScoreEditor::wake() {
+    const Uint32 type = wakeEventType.load();
+    if (type == (Uint32)-1) return;
+    SDL_Event wakeEvent{};
+    wakeEvent.type = type;
+    SDL_PushEvent(&wakeEvent);
+}
+
 int ScoreEditor::update() {
-    float elapsedTimeInSeconds = (SDL_GetTicks() - last_ticks) * 0.001f;
-    if (elapsedTimeInSeconds < minElapsedSecondsBetweenFrames) return updateCode_skip;
+    const bool isViewMoving = isLeftArrowHeld || isRightArrowHeld || isPlusKeyHeld || isMinusKeyHeld;
+    if (!needsRedraw && !isViewMoving && !SDL_WaitEventTimeout(NULL, idleWaitMilliseconds)) return updateCode_skip;
+    
+    // // limit the frame rate by sleeping, not by spinning
+    const long minTicksBetweenFrames = (long)(minElapsedSecondsBetweenFrames*1000.f);
+    const long elapsedTicks = (long)SDL_GetTicks() - last_ticks;
+    if (elapsedTicks < minTicksBetweenFrames) SDL_Delay((Uint32)(minTicksBetweenFrames - elapsedTicks));
+    float elapsedTimeInSeconds = std::min((SDL_GetTicks() - last_ticks) * 0.001f, maxElapsedSecondsBetweenFrames);
     last_ticks = SDL_GetTicks();
+    needsRedraw = false;
     
     //////////////////////////////////////
     mouseX_taktsFromRoot_prev = mouseX_taktsFromRoot;
@@ -69,11 +92,7 @@ int ScoreEditor::update() {
     hasEditModeChanged = false;
     isMouseClick = false;
     isMouseUnclick = false;
-    
-    static bool isLeftArrowHeld = false;
-    static bool isRightArrowHeld = false;
-    static bool isPlusKeyHeld = false;
-    static bool isMinusKeyHeld = false;
+    isPlaybackToggleRequested = false;
     //////////////////////////////////////
     
     while (SDL_PollEvent(&event)) {
@@ -146,6 +165,10 @@ int ScoreEditor::update() {
                 break;
         }
         
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_SPACE && event.key.repeat == 0) {
+            isPlaybackToggleRequested = true;
+        }
+        
         if (event.type == SDL_MOUSEBUTTONDOWN) {
             isMouseClick = true;
             isMouseHeldDown = true;
@@ -216,39 +239,17 @@ int ScoreEditor::update() {
                     menu.childNodeId = -1;
                     menu.state = Menu::State::Opened;
                     menu.quantizedSemitonesFromParent = quantizedStSep;
-                    int menuCollectionId = quantizedStSep;
-                    discrete::Monzo octaveCompensation(1);
-                    while (menuCollectionId <= -12) {
-                        menuCollectionId += 12;
-                        octaveCompensation /= discrete::Monzo(2);
-                    }
-                    while (menuCollectionId >= 12) {
-                        menuCollectionId -= 12;
-                        octaveCompensation *= discrete::Monzo(2);
-                    }
-                    int sgn = menuCollectionId < 0 ? -1 : 1;
-                    if (sgn == -1) menuCollectionId = -menuCollectionId;
-                    const auto& ratios = menuCollections[menuCollectionId].ratios;
-                    menu.items.resize(ratios.size());    
-                    if (sgn == 1) {
-                        for (int i = 0; i < ratios.size(); ++i) {
-                            menu.items[i].ratio = ratios[i] * octaveCompensation;
-                        }
-                        menu.centerItemId = menuCollections[menuCollectionId].centerItemId;
-                    }
-                    else {
-                        for (int i = 0; i < ratios.size(); ++i) {
-                            menu.items[i].ratio = discrete::Monzo(1)/ratios[ratios.size()-1-i] * octaveCompensation;
-                        }
-                        menu.centerItemId = ratios.size()-1 - menuCollections[menuCollectionId].centerItemId;
+                    const RatioMenus::Collection& collection = ratioMenus->getCollection(quantizedStSep);
+                    menu.items.resize(collection.ratios.size());
+                    for (int i = 0; i < menu.items.size(); ++i) {
+                        menu.items[i].ratio = collection.ratios[i];
+                        menu.items[i].label = collection.labels[i];
                     }
+                    menu.centerItemId = collection.centerItemId;
                     //menu.centerItemTaktsFromRoot = roundint(mouseX_taktsFromRoot-0.5f)+0.5f;
                     //menu.centerItemSemitonesFromRoot = std::round(mouseY_semitonesFromRoot - nodes[menu.parentNodeId].semitonesFromRoot) + nodes[menu.parentNodeId].semitonesFromRoot;
                     menu.navelTaktsFromRoot = AddNodes_navelTaktsFromRoot;
                     menu.navelSemitonesFromRoot = AddNodes_navelSemitonesFromRoot;//std::round(mouseY_semitonesFromRoot - nodes[menu.parentNodeId].semitonesFromRoot) + nodes[menu.parentNodeId].semitonesFromRoot;
-                    for (int i = 0; i < menu.items.size(); ++i) { 
-                        menu.items[i].label = std::to_string((int)menu.items[i].ratio.numerator())+":"+std::to_string((int)menu.items[i].ratio.denominator());
-                    }
                 }
             }
         }
@@ -263,6 +264,7 @@ int ScoreEditor::update() {
             }
             else if (idHover != -1 && DeleteNodes_selectedId == idHover) {
                 if (0 == scoreFile.deleteNode(idHover)) {
+                    idHeld = -1; // // its slot is free now
                     readNodes();
                 }
                 else {
@@ -280,46 +282,23 @@ int ScoreEditor::update() {
         if (isMouseClick && idHover != -1 && menu.state == Menu::State::Closed && idHover != scoreFile.getRootId()) {
             int id = idHover;
             int parentId = scoreFile.getParentId(id);
-            discrete::Monzo ratio = scoreFile.getRelativeRatio(parentId, id);
-            int quantizedStSep = roundint(12. * std::log2((double)ratio));
+            int quantizedStSep = roundint(12. * scoreFile.getRelativeOctaves(parentId, id));
 
             menu.parentNodeId = parentId;
             menu.childNodeId = id;
             menu.state = Menu::State::Opened; ChangeRatio_menuJustOpened = true;
             menu.quantizedSemitonesFromParent = quantizedStSep;
-            int menuCollectionId = quantizedStSep;
-            discrete::Monzo octaveCompensation(1);
-            while (menuCollectionId <= -12) {
-                menuCollectionId += 12;
-                octaveCompensation /= discrete::Monzo(2);
-            }
-            while (menuCollectionId >= 12) {
-                menuCollectionId -= 12;
-                octaveCompensation *= discrete::Monzo(2);
-            }
-            int sgn = menuCollectionId < 0 ? -1 : 1;
-            if (sgn == -1) menuCollectionId = -menuCollectionId;
-            const auto& ratios = menuCollections[menuCollectionId].ratios;
-            menu.items.resize(ratios.size());    
-            if (sgn == 1) {
-                for (int i = 0; i < ratios.size(); ++i) {
-                    menu.items[i].ratio = ratios[i] * octaveCompensation;
-                }
-                menu.centerItemId = menuCollections[menuCollectionId].centerItemId;
-            }
-            else {
-                for (int i = 0; i < ratios.size(); ++i) {
-                    menu.items[i].ratio = discrete::Monzo(1)/ratios[ratios.size()-1-i] * octaveCompensation;
-                }
-                menu.centerItemId = ratios.size()-1 - menuCollections[menuCollectionId].centerItemId;
+            const RatioMenus::Collection& collection = ratioMenus->getCollection(quantizedStSep);
+            menu.items.resize(collection.ratios.size());
+            for (int i = 0; i < menu.items.size(); ++i) {
+                menu.items[i].ratio = collection.ratios[i];
+                menu.items[i].label = collection.labels[i];
             }
+            menu.centerItemId = collection.centerItemId;
             //menu.centerItemTaktsFromRoot = roundint(mouseX_taktsFromRoot-0.5f)+0.5f;
             //menu.centerItemSemitonesFromRoot = std::round(mouseY_semitonesFromRoot - nodes[menu.parentNodeId].semitonesFromRoot) + nodes[menu.parentNodeId].semitonesFromRoot;
             menu.navelTaktsFromRoot = nodes[id].taktsFromRoot + 0.5f;
             menu.navelSemitonesFromRoot = nodes[parentId].semitonesFromRoot + menu.quantizedSemitonesFromParent;//std::round(mouseY_semitonesFromRoot - nodes[menu.parentNodeId].semitonesFromRoot) + nodes[menu.parentNodeId].semitonesFromRoot;
-            for (int i = 0; i < menu.items.size(); ++i) { 
-                menu.items[i].label = std::to_string((int)menu.items[i].ratio.numerator())+":"+std::to_string((int)menu.items[i].ratio.denominator());
-            }
         }
     }
     else if (editMode == EditMode::ChangeParent) {
@@ -332,8 +311,8 @@ int ScoreEditor::update() {
     }
     else if (editMode == EditMode::ChangeRoot) {
         if (isMouseClick && idHeld != -1 && idHeld != scoreFile.getRootId()) {
-            rootPositionInPixels[0] = nodes[idHeld].x1;
-            rootPositionInPixels[1] = nodes[idHeld].verticalCenter;
+            rootPositionInPixels[0] = taktsToWindowX(nodes[idHeld].taktsFromRoot);
+            rootPositionInPixels[1] = semitonesToWindowY(nodes[idHeld].semitonesFromRoot);
             scoreFile.changeRoot(idHeld);
             readNodes();
             std::cout << ">> changed root\n";
@@ -435,6 +414,28 @@ int ScoreEditor::update() {
     return 0;
 }
 
+bool ScoreEditor::ScoreRegion::intersects(float takts1, float takts2, float semitones1, float semitones2) const {
+    return takts2 >= taktsMin && takts1 <= taktsMax && semitones2 >= semitonesMin && semitones1 <= semitonesMax;
+}
+
+ScoreEditor::ScoreRegion ScoreEditor::getVisibleRegion() const {
+    const float margin = 16; // // room for the arrow tips
+    return {
+        (-margin - rootPositionInPixels[0]) / taktSizeInPixels,
+        (windowWidthInPixels + margin - rootPositionInPixels[0]) / taktSizeInPixels,
+        -(windowHeightInPixels + margin - rootPositionInPixels[1]) / semitoneSizeInPixels,
+        -(-margin - rootPositionInPixels[1]) / semitoneSizeInPixels
+    };
+}
+
+float ScoreEditor::taktsToWindowX(float takts) const {
+    return rootPositionInPixels[0] + takts*taktSizeInPixels;
+}
+
+float ScoreEditor::semitonesToWindowY(float semitones) const {
+    return rootPositionInPixels[1] - semitones*semitoneSizeInPixels;
+}
+
 int ScoreEditor::draw() {
     SDL_SetRenderDrawColor(renderer, color_back[0], color_back[1], color_back[2], color_back[3]);
     SDL_RenderClear(renderer);
@@ -464,28 +465,64 @@ int ScoreEditor::draw() {
         }
     }
     
-    // // nodes
-    for (const Node& n : nodes) {
-        int x1 = roundint(n.x1), y1 = roundint(n.y1);
-        int x2 = roundint(n.x2), y2 = roundint(n.y2);
-        SDL_Rect rect = {x1, y1, x2-x1, y2-y1};
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 100);
-        SDL_RenderFillRect(renderer, &rect);
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 150);
-        drawRectangleContour(renderer, rect.x, rect.y, rect.x+rect.w, rect.y+rect.h);
-    }
-    for (int id = 0; id < nodes.size(); ++id) {
+    // // nodes: the grid lists those inside the window, and only they are mapped to it. All the fills and all the
+    // // contours are submitted in one call each
+    const ScoreRegion visibleRegion = getVisibleRegion();
+    grid.query((int)std::floor(visibleRegion.semitonesMin)-2, (int)std::ceil(visibleRegion.semitonesMax)+2,
+               (int)std::floor(visibleRegion.taktsMin)-1, (int)std::ceil(visibleRegion.taktsMax), visibleNodeIds);
+    visibleFills.clear();
+    visibleContours.clear();
+    for (int id : visibleNodeIds) {
+        const Node& n = nodes[id];
+        if (!visibleRegion.intersects(n.taktsFromRoot, n.taktsFromRoot + n.durationInTakts, n.semitonesFromRoot - 1, n.semitonesFromRoot + 1)) continue;
+        float fx1, fy1, fx2, fy2;
+        n.getWindowRect(fx1, fy1, fx2, fy2);
+        int x1 = roundint(fx1), y1 = roundint(fy1);
+        int x2 = roundint(fx2), y2 = roundint(fy2);
+        visibleFills.push_back({x1, y1, x2-x1, y2-y1});
+        visibleContours.push_back({x1, y1, x2-x1+1, y2-y1+1}); // // SDL_RenderDrawRects excludes the far edges
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 100);
+    SDL_RenderFillRects(renderer, visibleFills.data(), (int)visibleFills.size());
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderDrawRects(renderer, visibleContours.data(), (int)visibleContours.size());
+    
+    // // arrows whose bounding box crosses the window, one polyline each. An arrow may cross the window with both ends
+    // // outside it: the short ones are looked for around the window, by their child, and the long ones are all tested.
+    // // The test is in score space; only the arrows that pass are mapped to the window
+    SDL_SetRenderDrawColor(renderer, 0,0,0,255);
+    auto drawArrowToNode = [&](int id) {
         int parentId = scoreFile.getParentId(id);
-        if (parentId == ScoreFile::Node::NULL_ID) continue;
+        if (parentId == ScoreFile::Node::NULL_ID) return;
         const Node& m = nodes[parentId];
-        Node& n = nodes[id];
-        SDL_SetRenderDrawColor(renderer, 0,0,0,255);
-        drawArrow(renderer, m.horizontalCenter, m.verticalCenter, n.horizontalCenter, n.verticalCenter);
+        const Node& n = nodes[id];
+        const float mt = m.taktsFromRoot + m.durationInTakts*0.5f, nt = n.taktsFromRoot + n.durationInTakts*0.5f;
+        if (!visibleRegion.intersects(std::min(mt, nt), std::max(mt, nt),
+                                      std::min(m.semitonesFromRoot, n.semitonesFromRoot), std::max(m.semitonesFromRoot, n.semitonesFromRoot))) return;
+        float x1, y1, x2, y2;
+        m.getWindowCenter(x1, y1);
+        n.getWindowCenter(x2, y2);
+        drawArrow(renderer, x1, y1, x2, y2);
+    };
+    grid.query((int)std::floor(visibleRegion.semitonesMin)-shortArrowSemitones-2, (int)std::ceil(visibleRegion.semitonesMax)+shortArrowSemitones+2,
+               (int)std::floor(visibleRegion.taktsMin)-shortArrowTakts-1, (int)std::ceil(visibleRegion.taktsMax)+shortArrowTakts, arrowNodeIds);
+    for (int id : arrowNodeIds) {
+        if (nodes[id].longArrowIndex == -1) drawArrowToNode(id);
+    }
+    for (int id : longArrowIds) drawArrowToNode(id);
+    
+    // // playback cursor
+    if (isPlaybackCursorVisible) {
+        int x = roundint(rootPositionInPixels[0] + (float)playbackCursorTakts*taktSizeInPixels);
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200);
+        SDL_RenderDrawLine(renderer, x, 0, x, windowHeightInPixels);
     }
     
     if (editMode == EditMode::ConsultRatios) {
         if (idHeld != -1) {
-            drawArrow(renderer, nodes[idHeld].horizontalCenter, nodes[idHeld].verticalCenter, mouseX_pixels, mouseY_pixels);
+            float heldX, heldY;
+            nodes[idHeld].getWindowCenter(heldX, heldY);
+            drawArrow(renderer, heldX, heldY, mouseX_pixels, mouseY_pixels);
             
             if (idHover != -1) {
                 int idFrom = idHeld, idTo = idHover;
@@ -501,14 +538,9 @@ int ScoreEditor::draw() {
                     label = std::to_string((int)ratio.numerator())+":"+std::to_string((int)ratio.denominator());
                 }
                 
-                float x1 = m.horizontalCenter;
-                float y1 = m.verticalCenter;
-                float x2 = n.horizontalCenter;
-                float y2 = n.verticalCenter;
-                SDL_Color textColor = {255, 255, 255}; // White color
-                SDL_Surface* textSurface = TTF_RenderText_Solid(font, label.c_str(), textColor);
-                SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-                
+                float x1, y1, x2, y2;
+                m.getWindowCenter(x1, y1);
+                n.getWindowCenter(x2, y2);
                 float x = (x1 + x2) * 0.5f, y = (y1 + y2) * 0.5f;
                 
                 int textWidth, textHeight;
@@ -523,14 +555,14 @@ int ScoreEditor::draw() {
                 SDL_SetRenderDrawColor(renderer, 210,102,205,255);
                 SDL_RenderFillRect(renderer, &destinationRect);
                 
-                renderTextCentered(renderer, font, label.c_str(), destinationRect);
+                renderTextCentered(renderer, textCache, font, label.c_str(), destinationRect);
             }
         }
     }
     if (editMode == EditMode::ConsultNotes) {
         if (idHeld != -1) {
             double f = scoreFile.getFrequency(idHeld);
-            double m = dsp::ftom(f); //////////////////////////////
+            double m = 69. + 12.*std::log2(f/440.); // ftom
             double n[2]{m-60., 0.};
             while (n[0] >= 12) {
                 n[0] -= 12;
@@ -577,26 +609,22 @@ int ScoreEditor::draw() {
             // // draw it
             std::string label = noteNames[n0i] + std::to_string(4+nOct) + " " + centsStr;
             
-            SDL_Color textColor = {255, 255, 255}; // White color
-            SDL_Surface* textSurface = TTF_RenderText_Solid(font, label.c_str(), textColor);
-            SDL_Texture* textTexture = SDL_CreateTextureFromSurface(renderer, textSurface);
-            
-            int textWidth, textHeight;
-            TTF_SizeText(font, label.c_str(), &textWidth, &textHeight);
+            SDL_Color textColor = {255, 255, 255, 255}; // White color
+            const TextCache::Entry* text = textCache.get(renderer, font, label, textColor);
+            int textWidth = text ? text->width : 0, textHeight = text ? text->height : 0;
             
-            const Node& node = nodes[idHeld];
+            float x, y;
+            nodes[idHeld].getWindowCenter(x, y);
             SDL_Rect destinationRect;
-            destinationRect.x = node.horizontalCenter - textWidth/2;
-            destinationRect.y = node.verticalCenter - textHeight/2;
+            destinationRect.x = x - textWidth/2;
+            destinationRect.y = y - textHeight/2;
             destinationRect.w = textWidth;
             destinationRect.h = textHeight;
             
             SDL_SetRenderDrawColor(renderer, 210,102,205,255);
             SDL_RenderFillRect(renderer, &destinationRect);
             
-            SDL_RenderCopy(renderer, textTexture, NULL, &destinationRect);
-            SDL_FreeSurface(textSurface);
-            SDL_DestroyTexture(textTexture);
+            if (text) SDL_RenderCopy(renderer, text->texture, NULL, &destinationRect);
         }
     }
     else if (editMode == EditMode::AddNodes) {
@@ -607,23 +635,24 @@ int ScoreEditor::draw() {
         }
         if (menu.state != Menu::State::ClosingProcess && (menu.state == Menu::State::Opened || idHeld != -1)) {
             const Node& n = nodes[idHeld != -1 ? idHeld : menu.parentNodeId];
-            float a1 = n.horizontalCenter;
-            float b1 = n.verticalCenter;
+            float a1, b1;
+            n.getWindowCenter(a1, b1);
             float a2 = rootPositionInPixels[0]+AddNodes_navelTaktsFromRoot*taktSizeInPixels;//(x1+x2)*0.5f;
             float b2 = rootPositionInPixels[1]-AddNodes_navelSemitonesFromRoot*semitoneSizeInPixels;//(y1+y2)*0.5f;
             drawArrow(renderer, a1, b1, a2, b2);
             if (a1 > a2) std::swap(a1, a2);
             if (b1 > b2) std::swap(b1, b2);
             int st = (menu.state == Menu::State::Opened ? menu.quantizedSemitonesFromParent : AddNodes_navelQuantizedSemitonesFromParent);
-            renderTextCentered(renderer, font, std::to_string(st).c_str(), SDL_Rect{roundint(a1), roundint(b1), roundint(a2-a1), roundint(b2-b1)});
+            renderTextCentered(renderer, textCache, font, std::to_string(st).c_str(), SDL_Rect{roundint(a1), roundint(b1), roundint(a2-a1), roundint(b2-b1)});
         }
     }
     else if (editMode == EditMode::DeleteNodes) {
         if (DeleteNodes_selectedId != -1) {
-            const Node& n = nodes[DeleteNodes_selectedId];
+            float x1, y1, x2, y2;
+            nodes[DeleteNodes_selectedId].getWindowRect(x1, y1, x2, y2);
             SDL_Rect rect = {
-                roundint(n.x1), roundint(n.y1), 
-                roundint(n.x2-n.x1), roundint(n.y2-n.y1)
+                roundint(x1), roundint(y1), 
+                roundint(x2-x1), roundint(y2-y1)
             };
             SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
             SDL_SetRenderDrawColor(renderer, 255, 0, 0, 200);
@@ -636,18 +665,20 @@ int ScoreEditor::draw() {
             int idTo = idHeld;
             const Node& m = nodes[scoreFile.getParentId(idTo)];
             const Node& n = nodes[idTo];
-            float a1 = m.horizontalCenter, b1 = m.verticalCenter, a2 = n.horizontalCenter, b2 = n.verticalCenter;
+            float a1, b1, a2, b2;
+            m.getWindowCenter(a1, b1);
+            n.getWindowCenter(a2, b2);
             SDL_SetRenderDrawColor(renderer, 255,0,0,255);
             drawArrow(renderer, a1, b1, a2, b2);
             SDL_SetRenderDrawColor(renderer, 0,0,0,255);
-            float c1 = mouseX_pixels, d1 = mouseY_pixels, c2 = nodes[idTo].horizontalCenter, d2 = nodes[idTo].verticalCenter;
+            float c1 = mouseX_pixels, d1 = mouseY_pixels, c2 = a2, d2 = b2;
             if (scoreFile.getParentId(idTo) != idHover) {
                 drawArrow(renderer, c1, d1, c2, d2);
             }
             if (idHover != -1 && idHover != idTo) {
                 int idFrom = idHover;
                 int st = roundint(nodes[idTo].semitonesFromRoot - nodes[idFrom].semitonesFromRoot);
-                renderTextCentered(renderer, font, std::to_string(st).c_str(), SDL_Rect{roundint(c1), roundint(d1), roundint(c2-c1), roundint(d2-d1)});
+                renderTextCentered(renderer, textCache, font, std::to_string(st).c_str(), SDL_Rect{roundint(c1), roundint(d1), roundint(c2-c1), roundint(d2-d1)});
             }
         }
     }
@@ -676,13 +707,13 @@ int ScoreEditor::draw() {
             if (i == menu.centerItemId) {
                 drawRectangleContour(renderer, x1, y1, x2, y2);
             }
-            //renderTextCentered(renderer, font, menuItems[i].label.c_str(), rectangle);
+            //renderTextCentered(renderer, textCache, font, menuItems[i].label.c_str(), rectangle);
             if (menu.itemId == i) {
                 SDL_SetRenderDrawColor(renderer, 0, 0, 0, 40);
                 SDL_RenderFillRect(renderer, &rectangle);
             }
             
-            renderTextCentered(renderer, font, menu.items[i].label.c_str(), rectangle);
+            renderTextCentered(renderer, textCache, font, menu.items[i].label.c_str(), rectangle);
         }
     }
     
@@ -692,44 +723,121 @@ int ScoreEditor::draw() {
 
 void ScoreEditor::Node::readScoreNode(const ScoreFile::Node& n) {
     taktsFromRoot = parent->scoreFile.getRelativePositionInTakts(parent->scoreFile.getRootId(), n.id);
-    discrete::Monzo ratio = parent->scoreFile.getRelativeRatio(parent->scoreFile.getRootId(), n.id);
-    
-    semitonesFromRoot = (float)(12.0 * std::log2((double)ratio));
-    horizontalLeftPosition = parent->rootPositionInPixels[0] + taktsFromRoot * parent->taktSizeInPixels;
-    verticalCenter = parent->rootPositionInPixels[1] - semitonesFromRoot*parent->semitoneSizeInPixels;
-    x1 = horizontalLeftPosition;
-    x2 = horizontalLeftPosition + parent->taktSizeInPixels * n.durationInTakts;
-    y1 = verticalCenter - parent->semitoneSizeInPixels;
-    y2 = verticalCenter + parent->semitoneSizeInPixels;
-    horizontalCenter = (x1 + x2) * 0.5f;
+    semitonesFromRoot = (float)(12.0 * parent->scoreFile.getRelativeOctaves(parent->scoreFile.getRootId(), n.id));
+    semitoneRow = roundint(semitonesFromRoot);
+    durationInTakts = n.durationInTakts;
     
     if (n.id != parent->scoreFile.getRootId()) {
-        discrete::Monzo ratioFP = n.ratioFromParent;
-        ratioFromParent[0] = ratioFP.numerator();
-        ratioFromParent[1] = ratioFP.denominator();
+        if (n.isSmallRatio) {
+            ratioFromParent[0] = n.smallRatioFromParent.numerator();
+            ratioFromParent[1] = n.smallRatioFromParent.denominator();
+        }
+        else {
+            discrete::Monzo ratioFP = n.ratioFromParent;
+            ratioFromParent[0] = ratioFP.numerator();
+            ratioFromParent[1] = ratioFP.denominator();
+        }
         ratioFromParentLabel = std::to_string((int)ratioFromParent[0])+":"+std::to_string((int)ratioFromParent[1]);
     }
 }
 
+void ScoreEditor::Node::getWindowRect(float& x1, float& y1, float& x2, float& y2) const {
+    x1 = parent->taktsToWindowX(taktsFromRoot);
+    x2 = x1 + parent->taktSizeInPixels * durationInTakts;
+    const float verticalCenter = parent->semitonesToWindowY(semitonesFromRoot);
+    y1 = verticalCenter - parent->semitoneSizeInPixels;
+    y2 = verticalCenter + parent->semitoneSizeInPixels;
+}
+
+void ScoreEditor::Node::getWindowCenter(float& x, float& y) const {
+    x = parent->taktsToWindowX(taktsFromRoot + durationInTakts*0.5f);
+    y = parent->semitonesToWindowY(semitonesFromRoot);
+}
+
 void ScoreEditor::readNodes() {
-    const int nNodes = scoreFile.getNumberOfNodes();
+    const bool areAllDirty = scoreFile.takeDirtyNodeIds(dirtyNodeIds) || nodes.empty();
+    const int nNodes = scoreFile.getNumberOfSlots();
+    for (int i = nNodes; i < nodes.size(); ++i) {
+        const Node& n = nodes[i];
+        if (n.isInGrid) grid.remove(i, n.semitoneRow, n.taktsFromRoot, n.durationInTakts);
+    }
     if (nodes.size() > nNodes) nodes.erase(nodes.begin()+nNodes, nodes.end());
     else if (nodes.size() < nNodes) {
-        nodes.reserve(nNodes);
         for (int i = nodes.size(); i < nNodes; ++i) {
             nodes.emplace_back(this);
         }
     }
-    for (int i = 0; i < nodes.size(); ++i) {
-        nodes[i].readScoreNode(scoreFile.getNode(i));
+    if (areAllDirty) {
+        longArrowIds.clear();
+        for (int i = 0; i < nodes.size(); ++i) {
+            nodes[i].longArrowIndex = -1;
+            readNode(i);
+        }
+        for (int i = 0; i < nodes.size(); ++i) fileArrow(i);
+    }
+    else {
+        for (int i : dirtyNodeIds) readNode(i);
+        // // once every node is read: a node that moved or changed duration also moves the arrows to its children
+        for (int i : dirtyNodeIds) {
+            fileArrow(i);
+            if (nodes[i].isAlive) {
+                for (int c : scoreFile.getChildIds(i)) fileArrow(c);
+            }
+        }
     }
 }
 
+void ScoreEditor::fileArrow(int id) {
+    Node& n = nodes[id];
+    const int parentId = n.isAlive ? scoreFile.getParentId(id) : ScoreFile::Node::NULL_ID;
+    bool isLong = false;
+    if (parentId != ScoreFile::Node::NULL_ID) {
+        const Node& m = nodes[parentId];
+        // // between the centers, in half takts to stay in integers
+        isLong = std::abs(2*m.taktsFromRoot + m.durationInTakts - 2*n.taktsFromRoot - n.durationInTakts) > 2*shortArrowTakts ||
+                 std::abs(m.semitonesFromRoot - n.semitonesFromRoot) > shortArrowSemitones;
+    }
+    if (isLong == (n.longArrowIndex != -1)) return;
+    if (isLong) {
+        n.longArrowIndex = longArrowIds.size();
+        longArrowIds.push_back(id);
+    }
+    else {
+        const int lastId = longArrowIds.back();
+        longArrowIds[n.longArrowIndex] = lastId;
+        nodes[lastId].longArrowIndex = n.longArrowIndex;
+        longArrowIds.pop_back();
+        n.longArrowIndex = -1;
+    }
+}
+
+void ScoreEditor::readNode(int id) {
+    Node& n = nodes[id];
+    const bool wasInGrid = n.isInGrid;
+    const int oldRow = n.semitoneRow, oldTakts = n.taktsFromRoot, oldDuration = n.durationInTakts;
+    n.isAlive = scoreFile.isNode(id);
+    if (n.isAlive) n.readScoreNode(scoreFile.getNode(id));
+    
+    const bool hasMoved = !wasInGrid || !n.isAlive || n.semitoneRow != oldRow || n.taktsFromRoot != oldTakts || n.durationInTakts != oldDuration;
+    if (!hasMoved) return;
+    if (wasInGrid) grid.remove(id, oldRow, oldTakts, oldDuration);
+    if (n.isAlive) grid.insert(id, n.semitoneRow, n.taktsFromRoot, n.durationInTakts);
+    n.isInGrid = n.isAlive;
+}
+
+// // the mouse goes to score space, where the nodes are
 int ScoreEditor::getNodeInWindowPosition(float x, float y) {
+    // // a rectangle spans one semitone above and below its row and includes its right edge
+    const float takts = (x - rootPositionInPixels[0]) / taktSizeInPixels;
+    const float semitones = -(y - rootPositionInPixels[1]) / semitoneSizeInPixels;
+    const int taktsFloor = (int)std::floor(takts);
+    grid.query(roundint(semitones)-2, roundint(semitones)+2, taktsFloor-1, taktsFloor, gridQueryResult);
+    
     int selectedNodeId = -1;
-    for (int i = 0; i < nodes.size(); ++i) {
+    for (int i : gridQueryResult) {
         const Node& n = nodes[i];
-        if (n.x1 <= x && x <= n.x2 && n.y1 <= y && y <= n.y2) {
+        if (n.taktsFromRoot <= takts && takts <= n.taktsFromRoot + n.durationInTakts && 
+            n.semitonesFromRoot - 1 <= semitones && semitones <= n.semitonesFromRoot + 1) {
             if (selectedNodeId != -1) { // // if click touches two rectangles, do as if it touched neither
                 selectedNodeId = -1;
                 break;
@@ -779,61 +887,15 @@ int ScoreEditor::getNodeInWindowPosition(float x, float y) {
     }
 }*/
 
-std::vector<ScoreEditor::MenuCollection> ScoreEditor::calculatePossibleRatios(const int N) {
-    std::set<discrete::Monzo> ratios;
-    for (int n = 3; n <= N; ++n) {
-        for (int d = n/2+1; d <= n; ++d) {
-            ratios.insert(discrete::Monzo(n) / discrete::Monzo(d));
-        }
-    }
-    
-    std::vector<MenuCollection> menuCollections;
-    menuCollections.resize(12);
-    for (auto r : ratios) {
-        double st = 12. * std::log2((double)r);
-        int stRound = roundint(st);
-        if (stRound == 12) {
-            stRound = 0;
-            r /= discrete::Monzo(2);
-        }
-        menuCollections[stRound].ratios.push_back(r);
-    }
-    std::sort(menuCollections[0].ratios.begin(), menuCollections[0].ratios.end());
-    
-    using Monzo = discrete::Monzo;
-    std::vector<discrete::Monzo> centers {
-        Monzo(1),
-        Monzo(16)/Monzo(15),
-        Monzo(9)/Monzo(8),
-        Monzo(6)/Monzo(5),
-        Monzo(5)/Monzo(4),
-        Monzo(4)/Monzo(3),
-        Monzo(10)/Monzo(7), ////////////////////////////////////////
-        Monzo(3)/Monzo(2),
-        Monzo(8)/Monzo(5),
-        Monzo(5)/Monzo(3),
-        Monzo(9)/Monzo(5),
-        Monzo(15)/Monzo(8)
-    };
-    
-    for (int i = 0; i < 12; ++i) {
-        const auto& v = menuCollections[i].ratios;
-        menuCollections[i].centerItemId = std::distance(v.begin(), std::find(v.begin(), v.end(), centers[i]));
-        if (menuCollections[i].centerItemId == v.size()) {
-            std::cerr << "WTF has happened with centers in ScoreEditor::ScoreEditor\n";
-            throw "err";
-        }
-    }
-    
-    return menuCollections;
-}
-
 bool ScoreEditor::doesPositionOverlapWithSomeNode(int taktsFromRoot, float semitonesFromRoot) const {
+    // // nodes less than half a semitone away lie in this row or in the adjacent ones
+    const int row = roundint(semitonesFromRoot);
+    grid.query(row-1, row+1, taktsFromRoot, taktsFromRoot, gridQueryResult);
     bool overlapsWithAnother = false;
-    for (int id = 0; id < nodes.size(); ++id) {
+    for (int id : gridQueryResult) {
         int taktSep = taktsFromRoot - nodes[id].taktsFromRoot;
         int stSep = roundint(semitonesFromRoot - nodes[id].semitonesFromRoot);
-        if (stSep == 0 && 0 <= taktSep && taktSep < scoreFile.getDurationInTakts(id)) {
+        if (stSep == 0 && 0 <= taktSep && taktSep < nodes[id].durationInTakts) {
             overlapsWithAnother = true;
             break;
         }
@@ -844,12 +906,14 @@ bool ScoreEditor::doesPositionOverlapWithSomeNode(int taktsFromRoot, float semit
 bool ScoreEditor::doesNodeRectangleOverlapWithSomeNode(int nodeId, int taktsFromRoot, float semitonesFromRoot, int durationInTakts) const {
     int this_min = taktsFromRoot;
     int this_max = this_min + durationInTakts;
+    const int row = roundint(semitonesFromRoot);
+    grid.query(row-1, row+1, this_min, std::max(this_max-1, this_min), gridQueryResult);
     bool overlapsWithAnother = false;
-    for (int id = 0; id < nodes.size(); ++id) {
+    for (int id : gridQueryResult) {
         if (id == nodeId) continue;
         int stSep = roundint(semitonesFromRoot - nodes[id].semitonesFromRoot);
         int other_min = nodes[id].taktsFromRoot;
-        int other_max = other_min + scoreFile.getDurationInTakts(id);
+        int other_max = other_min + nodes[id].durationInTakts;
         if (stSep == 0 && (other_min < this_max && this_min < other_max)) {
             overlapsWithAnother = true;
             break;
@@ -858,3 +922,46 @@ bool ScoreEditor::doesNodeRectangleOverlapWithSomeNode(int nodeId, int taktsFrom
     return overlapsWithAnother;
 }
 
+
+
+// // GRID
+int ScoreEditor::Grid::column(int takts) {
+    return takts >= 0 ? takts / taktsPerCell : -((-takts - 1) / taktsPerCell) - 1;
+}
+long long ScoreEditor::Grid::key(int row, int column) {
+    return ((long long)row << 32) | (unsigned)column;
+}
+void ScoreEditor::Grid::insert(int id, int row, int taktsFromRoot, int durationInTakts) {
+    const int last = column(taktsFromRoot + std::max(durationInTakts, 1) - 1);
+    for (int c = column(taktsFromRoot); c <= last; ++c) {
+        cells[key(row, c)].push_back(id);
+    }
+}
+void ScoreEditor::Grid::remove(int id, int row, int taktsFromRoot, int durationInTakts) {
+    const int last = column(taktsFromRoot + std::max(durationInTakts, 1) - 1);
+    for (int c = column(taktsFromRoot); c <= last; ++c) {
+        auto it = cells.find(key(row, c));
+        if (it == cells.end()) continue;
+        auto& ids = it->second;
+        auto jt = std::find(ids.begin(), ids.end(), id);
+        if (jt != ids.end()) {
+            *jt = ids.back();
+            ids.pop_back();
+        }
+        if (ids.empty()) cells.erase(it);
+    }
+}
+void ScoreEditor::Grid::query(int rowMin, int rowMax, int taktMin, int taktMax, std::vector<int>& result) const {
+    result.clear();
+    const int columnMin = column(taktMin), columnMax = column(taktMax);
+    for (int r = rowMin; r <= rowMax; ++r) {
+        for (int c = columnMin; c <= columnMax; ++c) {
+            auto it = cells.find(key(r, c));
+            if (it != cells.end()) result.insert(result.end(), it->second.begin(), it->second.end());
+        }
+    }
+    if (columnMin != columnMax) { // // long nodes are listed in several cells
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+}
\ No newline at end of file
@@ -2,12 +2,17 @@
 #define SCORE_EDITOR_H
 
 #include "ScoreFile.hpp"
+#include "RatioMenus.hpp"
+#include "TextCache.hpp"
 
 #include "../external/SDL2/include/SDL.h"
 #include "../external/SDL_ttf/include/SDL_ttf.h"
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
 
 struct ScoreEditor {
     ScoreEditor(ScoreFile& _scoreFile);
@@ -23,10 +28,24 @@ struct ScoreEditor {
     SDL_Window* window;
 	SDL_Renderer* renderer;
     TTF_Font* font;
+    TextCache textCache;
     SDL_Event event;
     
     long last_ticks = 0;
     const float minElapsedSecondsBetweenFrames = 1.f/200.f;
+    const float maxElapsedSecondsBetweenFrames = 1.f/30.f; // // the first frame after idling must not jump
+    
+    // // update sleeps in SDL_WaitEventTimeout until there is something to redraw: an input event, a held key,
+    // // needsRedraw, or a wake event pushed from another thread
+    bool needsRedraw = true;
+    const Uint32 idleWaitMilliseconds = 100;
+    inline static std::atomic<Uint32> wakeEventType{(Uint32)-1}; // // set by init, cleared by uninit, read by wake from any thread
+    static void wake(); // // thread-safe
+    
+    bool isLeftArrowHeld = false;
+    bool isRightArrowHeld = false;
+    bool isPlusKeyHeld = false;
+    bool isMinusKeyHeld = false;
     
     int color_back[4]{171,102,85,255};
     int color_menu[4]{255, 0, 0, 255};
@@ -43,21 +62,70 @@ struct ScoreEditor {
     int update();
     int draw();
     
+    // // per-frame buffers of draw, kept to avoid reallocations
+    std::vector<int> visibleNodeIds;
+    std::vector<int> arrowNodeIds;
+    std::vector<SDL_Rect> visibleFills;
+    std::vector<SDL_Rect> visibleContours;
+    
+    // // VIEW. Nodes stay in score space (takts and semitones from the root) and are mapped to the window only when drawn,
+    // // so pan and zoom change nothing but rootPositionInPixels, taktSizeInPixels and semitoneSizeInPixels
+    struct ScoreRegion {
+        float taktsMin, taktsMax, semitonesMin, semitonesMax;
+        bool intersects(float takts1, float takts2, float semitones1, float semitones2) const;
+    };
+    ScoreRegion getVisibleRegion() const; // // the window plus a margin for the arrow tips, in score space
+    float taktsToWindowX(float takts) const;
+    float semitonesToWindowY(float semitones) const;
+    
     struct Node {
         Node(const ScoreEditor* _parent) : parent{_parent} {}
         const ScoreEditor* parent;
-        void readScoreNode(const ScoreFile::Node& n);
+        void readScoreNode(const ScoreFile::Node& n); // // position, pitch, labels
+        bool isAlive = false; // // false for the free slots of the score
         int taktsFromRoot;
+        int durationInTakts;
         float semitonesFromRoot;
-        float horizontalLeftPosition, verticalCenter, horizontalCenter;
-        float x1, y1, x2, y2;
+        int semitoneRow; // // semitonesFromRoot rounded, the row of the node in the grid
+        bool isInGrid = false;
+        // // a rectangle spans one semitone above and below its row; the arrows join the centers
+        void getWindowRect(float& x1, float& y1, float& x2, float& y2) const;
+        void getWindowCenter(float& x, float& y) const;
         int ratioFromParent[2];
         std::string ratioFromParentLabel;
+        int longArrowIndex = -1; // // position in longArrowIds, if the arrow from the parent is long
+    };
+    
+    // // Uniform grid over score space, used by hit-tests and overlap checks. A cell covers taktsPerCell takts of one semitone row
+    // // and lists the nodes whose rectangle crosses it. readNodes keeps it in sync, moving only the nodes that changed
+    struct Grid {
+        inline static constexpr int taktsPerCell = 8;
+        std::unordered_map<long long, std::vector<int>> cells;
+        static int column(int takts);
+        static long long key(int row, int column);
+        void insert(int id, int row, int taktsFromRoot, int durationInTakts);
+        void remove(int id, int row, int taktsFromRoot, int durationInTakts);
+        // // collects (without repetitions) the nodes of the rows [rowMin, rowMax] that may cross the takts [taktMin, taktMax]
+        void query(int rowMin, int rowMax, int taktMin, int taktMax, std::vector<int>& result) const;
     };
+    Grid grid;
+    mutable std::vector<int> gridQueryResult;
+    
+    // // draw finds the arrows through the grid, by their child: a short arrow, one that spans at most shortArrowTakts and
+    // // shortArrowSemitones, crosses the window only if its child lies within that distance of it. The few long arrows
+    // // are listed apart, by child id, and always tested. readNodes refiles the arrows of the nodes it rereads
+    inline static constexpr int shortArrowTakts = 16;
+    inline static constexpr int shortArrowSemitones = 24;
+    std::vector<int> longArrowIds;
+    void fileArrow(int childId);
+    
     int getNodeInWindowPosition(float x, float y);
     bool doesPositionOverlapWithSomeNode(int taktPositionFromRoot, float semitonePositionFromRoot) const;
     bool doesNodeRectangleOverlapWithSomeNode(int nodeId, int taktsFromRoot, float semitonesFromRoot, int durationInTakts) const;
+    // // brings nodes up to date with the score: rereads the nodes the score reports as changed
     void readNodes();
+    void readNode(int id);
+    std::vector<int> dirtyNodeIds;
     
     enum class EditMode { 
         ConsultNotes, ConsultRatios, AddNodes, DeleteNodes, AudioPlayback, HorizontalMovement, HorizontalScaling, ChangeRatio, ChangeParent, ChangeRoot
@@ -79,12 +147,7 @@ struct ScoreEditor {
         { EditMode::AudioPlayback, {'k', "audio playback"} },
     };
     
-    struct MenuCollection {
-        std::vector<discrete::Monzo> ratios;
-        int centerItemId;
-    };
-    std::vector<MenuCollection> menuCollections;
-    static std::vector<MenuCollection> calculatePossibleRatios(const int N);
+    std::shared_ptr<RatioMenus> ratioMenus; // // those of the current limit
     
     struct Menu {
         int itemWidthInPixels = 70;
@@ -132,6 +195,10 @@ struct ScoreEditor {
     bool isMouseClick;
     bool isMouseUnclick;
     
+    bool isPlaybackToggleRequested = false; // // space bar pressed in this frame
+    bool isPlaybackCursorVisible = false; // // set by the main loop while the transport plays
+    double playbackCursorTakts = 0;
+    
     int idHeld = -1;
     int idHover = -1;
     int idUnheld = -1;
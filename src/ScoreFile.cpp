@@ -1,7 +1,73 @@
 #include "ScoreFile.hpp"
 
 #include <fstream>
-#include <list>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+// // BINARY FORMAT
+// // A 40-byte header (magic, version, rootId, numberOfNodes, rootFrequency, taktDurationInSeconds, numberOfParams,
+// // reserved), the node array, 20 bytes per node (parentId, ratio numerator and denominator, position, duration; the id
+// // of a node is its position in the array), and then the params, each one as a 16-bit name length, the name bytes and a
+// // double. Every field is written and read byte by byte as little-endian, like WavWriter does, so files are the same on
+// // every host whatever its byte order and struct padding
+namespace score_binary {
+    inline constexpr char magic[4]{'J','U','I','S'};
+    inline constexpr std::uint32_t version = 1;
+    inline constexpr std::size_t headerSize = 40;
+    inline constexpr std::size_t nodeSize = 20;
+    
+    struct Writer {
+        std::vector<char> bytes;
+        void put(std::uint64_t x, int nBytes) {
+            for (int i = 0; i < nBytes; ++i) bytes.push_back((char)((x >> (8*i)) & 0xff));
+        }
+        void putInt32(std::int32_t x) { put((std::uint32_t)x, 4); }
+        void putDouble(double x) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &x, sizeof(bits));
+            put(bits, 8);
+        }
+    };
+    // // reads past the end return 0 and clear isValid, so callers check once after a group of fields
+    struct Reader {
+        const char* p;
+        const char* end;
+        bool isValid = true;
+        std::uint64_t get(int nBytes) {
+            if (end - p < nBytes) {
+                isValid = false;
+                p = end;
+                return 0;
+            }
+            std::uint64_t x = 0;
+            for (int i = 0; i < nBytes; ++i) x |= (std::uint64_t)(unsigned char)p[i] << (8*i);
+            p += nBytes;
+            return x;
+        }
+        std::int32_t getInt32() { return (std::int32_t)(std::uint32_t)get(4); }
+        double getDouble() {
+            std::uint64_t bits = get(8);
+            double x;
+            std::memcpy(&x, &bits, sizeof(x));
+            return x;
+        }
+    };
+}
 
 int ScoreFile::createBlank() {
     rootId = 0;
@@ -9,138 +75,468 @@ int ScoreFile::createBlank() {
     taktDurationInSeconds = 1.;
     
     nodes.clear();
+    params.clear();
     nodes.emplace_back();
     Node& n = nodes.back();
     n.id = 0;
     n.parentId = Node::NULL_ID;
-    n.ratioFromParent = discrete::Monzo(1);
+    setRatioFromParent(n, discrete::Monzo(1));
     n.positionInTaktsFromParent = 0;
     n.durationInTakts = 1;
+    resetSlots();
     return 0;
 }
+
+// // Fills a ScoreFile straight from the SAX events of the parser, without building a json DOM.
+// // Nesting levels: 1 top object, 2 "score" array / "params" object, 3 node objects, 4 "ratioFromParent" arrays
+struct ScoreFile::JsonLoader {
+    ScoreFile& scoreFile;
+    int depth = 0;
+    std::string topKey, nodeKey;
+    int ratioIndex = 0;
+    long long ratio[2];
+    int nodeFields = 0; // // bitmask of the fields read for the current node
+    int topFields = 0; // // bitmask of the top-level fields read
+    inline static constexpr int allNodeFields = 0b11111;
+    inline static constexpr int allTopFields = 0b1111;
+    bool isValid = true;
+    
+    bool number(long long i, double d) {
+        if (depth == 1) {
+            if (topKey == "rootId") { scoreFile.rootId = (int)i; topFields |= 1; }
+            else if (topKey == "rootFrequency") { scoreFile.rootFrequency = d; topFields |= 2; }
+            else if (topKey == "taktDurationInSeconds") { scoreFile.taktDurationInSeconds = d; topFields |= 4; }
+        }
+        else if (depth == 2 && topKey == "params") {
+            scoreFile.params[nodeKey] = d;
+        }
+        else if (depth == 3 && topKey == "score") {
+            Node& n = scoreFile.nodes.back();
+            if (nodeKey == "id") { n.id = (int)i; nodeFields |= 1; }
+            else if (nodeKey == "parentId") { n.parentId = (int)i; nodeFields |= 2; }
+            else if (nodeKey == "positionInTaktsFromParent") { n.positionInTaktsFromParent = (int)i; nodeFields |= 4; }
+            else if (nodeKey == "durationInTakts") { n.durationInTakts = (int)i; nodeFields |= 8; }
+        }
+        else if (depth == 4 && topKey == "score" && nodeKey == "ratioFromParent") {
+            if (ratioIndex < 2) ratio[ratioIndex] = i;
+            ++ratioIndex;
+        }
+        return true;
+    }
+    
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool number_integer(nlohmann::json::number_integer_t val) { return number(val, (double)val); }
+    bool number_unsigned(nlohmann::json::number_unsigned_t val) { return number((long long)val, (double)val); }
+    bool number_float(nlohmann::json::number_float_t val, const nlohmann::json::string_t&) { return number((long long)val, val); }
+    bool string(nlohmann::json::string_t&) { return true; }
+    bool binary(nlohmann::json::binary_t&) { return true; }
+    bool key(nlohmann::json::string_t& val) {
+        if (depth == 1) topKey = val;
+        else nodeKey = val;
+        return true;
+    }
+    bool start_object(std::size_t) {
+        ++depth;
+        if (depth == 2) nodeKey.clear();
+        if (depth == 3 && topKey == "score") {
+            scoreFile.nodes.emplace_back();
+            nodeFields = 0;
+        }
+        return true;
+    }
+    bool end_object() {
+        if (depth == 3 && topKey == "score" && nodeFields != allNodeFields) isValid = false;
+        --depth;
+        return true;
+    }
+    bool start_array(std::size_t) {
+        ++depth;
+        if (depth == 2 && topKey == "score") topFields |= 8;
+        if (depth == 4 && topKey == "score" && nodeKey == "ratioFromParent") ratioIndex = 0;
+        return true;
+    }
+    bool end_array() {
+        if (depth == 4 && topKey == "score" && nodeKey == "ratioFromParent") {
+            if (ratioIndex != 2 || !isFileRatio(ratio[0], ratio[1])) isValid = false;
+            else {
+                setRatioFromParent(scoreFile.nodes.back(), discrete::Monzo(ratio[0]) / discrete::Monzo(ratio[1]));
+                nodeFields |= 16;
+            }
+        }
+        --depth;
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) {
+        isValid = false;
+        return false;
+    }
+};
+
 int ScoreFile::readFromDisk(const char* path) {
-    std::ifstream f(path);
+    char fileMagic[4]{};
+    std::ifstream f(path, std::ios::binary);
     if (!f) return 1;
-    nlohmann::json data = nlohmann::json::parse(f);
-    rootId = data["rootId"];
-    rootFrequency = data["rootFrequency"];
-    taktDurationInSeconds = data["taktDurationInSeconds"];
-    nodes.clear();
-    nodes.reserve(data["score"].size());
-    for (int i = 0; i < data["score"].size(); ++i) {
-        nlohmann::json nodeData = data["score"][i];
-        nodes.emplace_back();
-        Node& n = nodes.back();
-        n.id = nodeData["id"];
-        n.parentId = nodeData["parentId"];
-        n.ratioFromParent = discrete::Monzo((int)nodeData["ratioFromParent"][0]) / discrete::Monzo((int)nodeData["ratioFromParent"][1]);
-        n.positionInTaktsFromParent = nodeData["positionInTaktsFromParent"];
-        n.durationInTakts = nodeData["durationInTakts"];
+    f.read(fileMagic, 4);
+    f.close();
+    if (0 == std::memcmp(fileMagic, score_binary::magic, 4)) return readBinaryFromDisk(path);
+    return readJsonFromDisk(path);
+}
+
+int ScoreFile::writeToDisk(const char* path) const {
+    return getSnapshot().writeToDisk(path);
+}
+
+ScoreFile::Snapshot ScoreFile::getSnapshot() const {
+    const std::vector<int> fileIds = getFileIds();
+    Snapshot snapshot;
+    snapshot.rootId = fileIds[rootId];
+    snapshot.rootFrequency = rootFrequency;
+    snapshot.taktDurationInSeconds = taktDurationInSeconds;
+    snapshot.params = params;
+    snapshot.records.resize(numberOfNodes);
+    for (const Node& n : nodes) {
+        if (n.id == Node::NULL_ID) continue;
+        Snapshot::Record& r = snapshot.records[fileIds[n.id]];
+        r.parentId = n.parentId == Node::NULL_ID ? Node::NULL_ID : fileIds[n.parentId];
+        if (0 != getFileRatio(n, r.ratioNumerator, r.ratioDenominator)) snapshot.areRatiosInRange = false;
+        r.positionInTaktsFromParent = n.positionInTaktsFromParent;
+        r.durationInTakts = n.durationInTakts;
     }
+    return snapshot;
+}
+
+int ScoreFile::Snapshot::writeToDisk(const char* path) const {
+    // // the previous contents of path stay intact until the new file is complete and on the disk
+    if (!areRatiosInRange) return 1;
+    std::string temporaryPath = std::string(path) + ".tmp";
+    int result = isBinaryPath(path) ? writeBinaryToDisk(temporaryPath.c_str()) : writeJsonToDisk(temporaryPath.c_str());
+    if (result == 0) result = syncFile(temporaryPath);
+    if (result == 0) result = replaceFile(temporaryPath, path);
+    if (result != 0) std::remove(temporaryPath.c_str());
+    return result;
+}
+
+int ScoreFile::syncFile(const std::string& path) {
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 1;
+    const bool isSynced = FlushFileBuffers(file);
+    CloseHandle(file);
+    return isSynced ? 0 : 1;
+    #else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return 1;
+    const int result = ::fsync(fd);
+    ::close(fd);
+    return result == 0 ? 0 : 1;
+    #endif
+}
+
+int ScoreFile::replaceFile(const std::string& fromPath, const std::string& toPath) {
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
+    return MoveFileExA(fromPath.c_str(), toPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : 1;
+    #else
+    if (std::rename(fromPath.c_str(), toPath.c_str()) != 0) return 1;
+    // // the rename itself is only durable once the directory is synced. The file is complete either way, so this may fail
+    std::string directory = std::filesystem::path(toPath).parent_path().string();
+    syncFile(directory.empty() ? "." : directory);
+    return 0;
+    #endif
+}
+
+bool ScoreFile::isBinaryPath(const std::string& path) {
+    return path.size() >= binaryExtension.size() && 0 == path.compare(path.size()-binaryExtension.size(), binaryExtension.size(), binaryExtension);
+}
+
+int ScoreFile::readJsonFromDisk(const char* path) {
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return 1;
+    // // parsed into a separate score, so that this one stays untouched if the file turns out to be invalid
+    ScoreFile loaded;
+    JsonLoader loader{loaded};
+    bool isParsed = nlohmann::json::sax_parse(f, &loader);
     f.close();
+    if (!isParsed || !loader.isValid || loader.topFields != JsonLoader::allTopFields) return 1;
+    if (0 != checkTree(loaded.nodes, loaded.rootId)) return 1;
+    
+    rootId = loaded.rootId;
+    rootFrequency = loaded.rootFrequency;
+    taktDurationInSeconds = loaded.taktDurationInSeconds;
+    nodes.swap(loaded.nodes);
+    params.swap(loaded.params);
+    resetSlots();
     return 0;
 }
 
-int ScoreFile::writeToDisk(const char* path) const {
+int ScoreFile::checkTree(const std::vector<Node>& nodes, int rootId) {
+    const int n = nodes.size();
+    if (rootId < 0 || rootId >= n) return 1;
+    // // Every node but the root has exactly one parent, so the nodes form a tree exactly when a walk down from the root
+    // // reaches all of them. A cycle is never reached, and cannot make the walk loop. The children are sorted by parent
+    // // in two flat arrays, like childLists but without a vector per node
+    std::vector<int> firstChild(n + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        const Node& node = nodes[i];
+        if (node.id != i || node.parentId < Node::NULL_ID || node.parentId >= n) return 1;
+        if ((node.parentId == Node::NULL_ID) != (i == rootId)) return 1;
+        if (i != rootId) ++firstChild[node.parentId + 1];
+    }
+    for (int i = 0; i < n; ++i) firstChild[i + 1] += firstChild[i];
+    std::vector<int> children(n);
+    std::vector<int> nextChild(firstChild.begin(), firstChild.end() - 1);
+    for (int i = 0; i < n; ++i) {
+        if (i != rootId) children[nextChild[nodes[i].parentId]++] = i;
+    }
+    
+    std::vector<int> reached{rootId}; // // breadth-first, the result itself is the queue
+    reached.reserve(n);
+    for (int q = 0; q < reached.size(); ++q) {
+        const int i = reached[q];
+        reached.insert(reached.end(), children.begin() + firstChild[i], children.begin() + firstChild[i + 1]);
+    }
+    return reached.size() == n ? 0 : 1;
+}
+
+bool ScoreFile::isFileRatio(long long numerator, long long denominator) {
+    return 0 < numerator && numerator <= INT32_MAX && 0 < denominator && denominator <= INT32_MAX;
+}
+
+int ScoreFile::getFileRatio(const Node& n, int& numerator, int& denominator) {
+    long long x, y;
+    if (n.isSmallRatio) {
+        if (0 != n.smallRatioFromParent.toFraction(INT32_MAX, x, y)) return 1;
+    }
+    else {
+        // // discrete::Monzo has no checked conversion and its products wrap when they overflow. A wrapped fraction
+        // // does not have the value of the ratio, which the comparison in double shows
+        x = n.ratioFromParent.numerator();
+        y = n.ratioFromParent.denominator();
+        if (!isFileRatio(x, y)) return 1;
+        const double value = (double)n.ratioFromParent;
+        if (std::abs((double)x / (double)y - value) > 1e-9 * value) return 1;
+    }
+    numerator = (int)x;
+    denominator = (int)y;
+    return 0;
+}
+
+int ScoreFile::readBinaryFromDisk(const char* path) {
+    // // one read of the whole file, then one sequential pass that decodes every node into the slots
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    const std::streamoff size = f.tellg();
+    if (!f || size < 0) return 1;
+    std::vector<char> bytes((std::size_t)size);
+    f.seekg(0);
+    f.read(bytes.data(), bytes.size());
+    if (!f) return 1;
+    f.close();
+    
+    score_binary::Reader r{bytes.data(), bytes.data() + bytes.size()};
+    char fileMagic[4];
+    for (char& c : fileMagic) c = (char)r.get(1);
+    const std::uint32_t fileVersion = (std::uint32_t)r.get(4);
+    const int fileRootId = r.getInt32();
+    const int n = r.getInt32();
+    const double fileRootFrequency = r.getDouble();
+    const double fileTaktDurationInSeconds = r.getDouble();
+    const int numberOfParams = r.getInt32();
+    r.get(4); // // reserved
+    if (!r.isValid || 0 != std::memcmp(fileMagic, score_binary::magic, 4) || fileVersion != score_binary::version) return 1;
+    if (n <= 0 || fileRootId < 0 || fileRootId >= n) return 1;
+    if ((std::size_t)(r.end - r.p) / score_binary::nodeSize < (std::size_t)n) return 1;
+    
+    // // decoded apart, so that this score stays untouched if the file turns out to be invalid
+    std::vector<Node> fileNodes(n);
+    for (int i = 0; i < n; ++i) {
+        Node& node = fileNodes[i];
+        node.id = i;
+        node.parentId = r.getInt32();
+        const int numerator = r.getInt32();
+        const int denominator = r.getInt32();
+        node.positionInTaktsFromParent = r.getInt32();
+        node.durationInTakts = r.getInt32();
+        if (!isFileRatio(numerator, denominator)) return 1;
+        setRatioFromParent(node, discrete::Monzo(numerator) / discrete::Monzo(denominator));
+    }
+    if (0 != checkTree(fileNodes, fileRootId)) return 1;
+    
+    std::map<std::string, double> fileParams;
+    for (int i = 0; i < numberOfParams; ++i) {
+        const int nameLength = (int)r.get(2);
+        if (!r.isValid || r.end - r.p < nameLength) return 1;
+        std::string name(r.p, nameLength);
+        r.p += nameLength;
+        fileParams[name] = r.getDouble();
+    }
+    if (!r.isValid) return 1;
+    
+    rootId = fileRootId;
+    rootFrequency = fileRootFrequency;
+    taktDurationInSeconds = fileTaktDurationInSeconds;
+    nodes.swap(fileNodes);
+    params.swap(fileParams);
+    resetSlots();
+    return 0;
+}
+
+int ScoreFile::Snapshot::writeBinaryToDisk(const char* path) const {
+    score_binary::Writer w;
+    w.bytes.reserve(score_binary::headerSize + records.size() * score_binary::nodeSize);
+    for (char c : score_binary::magic) w.put((unsigned char)c, 1);
+    w.put(score_binary::version, 4);
+    w.putInt32(rootId);
+    w.putInt32(records.size());
+    w.putDouble(rootFrequency);
+    w.putDouble(taktDurationInSeconds);
+    w.putInt32(params.size());
+    w.putInt32(0); // // reserved
+    
+    for (const Record& r : records) {
+        w.putInt32(r.parentId);
+        w.putInt32(r.ratioNumerator);
+        w.putInt32(r.ratioDenominator);
+        w.putInt32(r.positionInTaktsFromParent);
+        w.putInt32(r.durationInTakts);
+    }
+    for (const auto& [name, value] : params) {
+        const std::uint16_t nameLength = name.size();
+        w.put(nameLength, 2);
+        w.bytes.insert(w.bytes.end(), name.begin(), name.begin() + nameLength);
+        w.putDouble(value);
+    }
+    
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return 1;
+    f.write(w.bytes.data(), w.bytes.size());
+    f.close();
+    return f ? 0 : 1;
+}
+
+int ScoreFile::Snapshot::writeJsonToDisk(const char* path) const {
     nlohmann::json data;
     data["rootId"] = rootId;
     data["rootFrequency"] = rootFrequency;
     data["taktDurationInSeconds"] = taktDurationInSeconds;
     data["score"] = {};
-    for (int i = 0; i < nodes.size(); ++i) {
-        const auto& n = nodes[i];
+    for (int i = 0; i < records.size(); ++i) {
+        const Record& r = records[i];
         auto& d = data["score"][i];
-        d["id"] = n.id;
-        d["parentId"] = n.parentId;
-        d["ratioFromParent"] = {(int)n.ratioFromParent.numerator(), (int)n.ratioFromParent.denominator()};
-        d["positionInTaktsFromParent"] = n.positionInTaktsFromParent;
-        d["durationInTakts"] = n.durationInTakts;
+        d["id"] = i;
+        d["parentId"] = r.parentId;
+        d["ratioFromParent"] = {r.ratioNumerator, r.ratioDenominator};
+        d["positionInTaktsFromParent"] = r.positionInTaktsFromParent;
+        d["durationInTakts"] = r.durationInTakts;
+    }
+    for (const auto& [name, value] : params) {
+        data["params"][name] = value;
     }
     std::ofstream f(path);
     if (!f) return 1;
     f << data << std::endl;
     f.close();
-    return 0;
+    return f ? 0 : 1;
 }
 
-int ScoreFile::getNumberOfNodes() const { return nodes.size(); }
+ScoreFile::Handle ScoreFile::getHandle(int id) const {
+    if (!isNode(id)) return Handle{};
+    return Handle{id, generations[id]};
+}
+bool ScoreFile::isValid(Handle handle) const {
+    return isNode(handle.id) && generations[handle.id] == handle.generation;
+}
+
+int ScoreFile::getNumberOfNodes() const { return numberOfNodes; }
+int ScoreFile::getNumberOfSlots() const { return nodes.size(); }
+bool ScoreFile::isNode(int id) const { return 0 <= id && id < nodes.size() && nodes[id].id != Node::NULL_ID; }
 int ScoreFile::getRootId() const { return rootId; }
 double ScoreFile::getRootFrequency() const { return rootFrequency; }
 double ScoreFile::getTaktDurationInSeconds() const { return taktDurationInSeconds; }
+const std::vector<int>& ScoreFile::getChildIds(int id) const {
+    if (!isNode(id)) throw "Node not found";
+    return childLists[id];
+}
 int ScoreFile::getParentId(int id) const {
-    if (id >= nodes.size()) throw "err"; /////////////////////////////////////////////
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
     return nodes[id].parentId;
 }
 discrete::Monzo ScoreFile::getRatioFromParent(int id) const {
-    if (id >= nodes.size()) throw "err"; /////////////////////////////////////////////
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
     return nodes[id].ratioFromParent;
 }
 int ScoreFile::getPositionInTaktsFromParent(int id) const {
-    if (id >= nodes.size()) throw "err"; /////////////////////////////////////////////
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
     return nodes[id].positionInTaktsFromParent;
 }
 int ScoreFile::getDurationInTakts(int id) const {
-    if (id >= nodes.size()) throw "err"; /////////////////////////////////////////////
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
     return nodes[id].durationInTakts;
 }
 discrete::Monzo ScoreFile::getRelativeRatio(int fromId, int toId) const {
-    if (fromId >= nodes.size() || toId >= nodes.size()) throw "err"; ///////////////////////////////////////////
-    discrete::Monzo m(1);
-    for (int i = toId; i != rootId; i = nodes[i].parentId) {
-        m *= nodes[i].ratioFromParent;
-    }
-    for (int i = fromId; i != rootId; i = nodes[i].parentId) {
-        m /= nodes[i].ratioFromParent;
-    }
-    return m;
+    if (!isNode(fromId) || !isNode(toId)) throw "err"; ///////////////////////////////////////////
+    SmallMonzo ratio;
+    if (0 == getRelativeSmallRatio(fromId, toId, ratio)) return ratio.toMonzo();
+    return getAbsoluteData(toId).getRatio() / getAbsoluteData(fromId).getRatio();
 }    
+double ScoreFile::getRelativeOctaves(int fromId, int toId) const {
+    if (!isNode(fromId) || !isNode(toId)) throw "err"; ///////////////////////////////////////////
+    SmallMonzo ratio;
+    if (0 == getRelativeSmallRatio(fromId, toId, ratio)) return ratio.log2();
+    return std::log2((double)getRelativeRatio(fromId, toId));
+}
 int ScoreFile::getRelativePositionInTakts(int fromId, int toId) const {
-    if (fromId >= nodes.size() || toId >= nodes.size()) throw "err"; ///////////////////////////////////////////
-    int dur = 0;
-    for (int i = toId; i != rootId; i = nodes[i].parentId) {
-        dur += nodes[i].positionInTaktsFromParent;
-    }
-    for (int i = fromId; i != rootId; i = nodes[i].parentId) {
-        dur -= nodes[i].positionInTaktsFromParent;
-    }
-    return dur;
+    if (!isNode(fromId) || !isNode(toId)) throw "err"; ///////////////////////////////////////////
+    return getAbsoluteData(toId).positionInTakts - getAbsoluteData(fromId).positionInTakts;
 }
 double ScoreFile::getFrequency(int id) const {
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
+    SmallMonzo ratio;
+    if (0 == getRelativeSmallRatio(rootId, id, ratio)) return rootFrequency * (double)ratio;
     return rootFrequency * (double)getRelativeRatio(rootId, id);
 }
 
 const ScoreFile::Node& ScoreFile::getNode(int id) const { 
-    if (id >= nodes.size()) throw "err"; /////////////////////////////////////////////
+    if (!isNode(id)) throw "err"; /////////////////////////////////////////////
     return nodes[id];
 }
+const std::map<std::string, double>& ScoreFile::getParams() const { return params; }
+unsigned long long ScoreFile::getRevision() const { return revision; }
 
 // // MODIFY
 int ScoreFile::changeRoot(int newRootId) {
-    if (newRootId >= nodes.size()) return 1;
+    if (!isNode(newRootId)) return 1;
     if (newRootId == rootId) return 0;
 
+    // // the path between them reverses: the new root leaves its parent, the old root hangs from the new one
+    removeChild(nodes[newRootId].parentId, newRootId);
+    addChild(newRootId, rootId);
     nodes[rootId].parentId = newRootId;
-    nodes[rootId].ratioFromParent = getRelativeRatio(newRootId, rootId);
+    setRatioFromParent(nodes[rootId], getRelativeRatio(newRootId, rootId));
     nodes[rootId].positionInTaktsFromParent = getRelativePositionInTakts(newRootId, rootId);
     
     nodes[newRootId].parentId = Node::NULL_ID;
-    nodes[newRootId].ratioFromParent = discrete::Monzo(1);
+    setRatioFromParent(nodes[newRootId], discrete::Monzo(1));
     nodes[newRootId].positionInTaktsFromParent = 0;
     
     rootFrequency *= (double)(discrete::Monzo(1)/nodes[rootId].ratioFromParent);
     rootId = newRootId;
+    invalidateAllAbsoluteData();
+    markAllDirty();
+    ++revision;
     return 0;
 }
 int ScoreFile::changeRootFrequency(double newRootFrequency) {
     rootFrequency = newRootFrequency;
+    ++revision;
     return 0;
 }
 int ScoreFile::changeTaktDuration(double newTaktDuration) {
     taktDurationInSeconds = newTaktDuration;
+    ++revision;
     return 0;
 }
 int ScoreFile::changeParent(int id, int newParentId) {
-    if (id >= nodes.size() || newParentId >= nodes.size()) return 1;
+    if (!isNode(id) || !isNode(newParentId)) return 1;
     if (id == rootId) return 1;
     if (id == newParentId) return 1;
     if (newParentId == nodes[id].parentId) return 0;
@@ -150,79 +546,233 @@ int ScoreFile::changeParent(int id, int newParentId) {
         if (i == id) return 1;
     }
     
-    nodes[id].ratioFromParent = getRelativeRatio(newParentId, id);
+    setRatioFromParent(nodes[id], getRelativeRatio(newParentId, id));
     nodes[id].positionInTaktsFromParent = getRelativePositionInTakts(newParentId, id);
+    removeChild(nodes[id].parentId, id);
+    addChild(newParentId, id);
     nodes[id].parentId = newParentId;
+    // // the node keeps its absolute ratio and position, so the cache stays valid; only its ratio from the parent changes
+    markDirty(id);
+    ++revision;
     return 0;
 }
 int ScoreFile::changeRatio(int id, discrete::Monzo newRatio) {
-    if (id >= nodes.size()) return 1;
-    nodes[id].ratioFromParent = newRatio;
+    if (!isNode(id)) return 1;
+    setRatioFromParent(nodes[id], newRatio);
+    invalidateAbsoluteDataOfSubtree(id);
+    for (int i : absoluteCachePath) markDirty(i); // // the subtree, collected by invalidateAbsoluteDataOfSubtree
+    ++revision;
     return 0;
 }
 int ScoreFile::incrementPositionInTaktsFromParent(int id, int incrementInTakts) {
-    if (id >= nodes.size()) return 1;
-    for (Node& n : nodes) {
-        if (n.parentId == id) n.positionInTaktsFromParent -= incrementInTakts;
-    }
+    if (!isNode(id)) return 1;
+    for (int c : childLists[id]) nodes[c].positionInTaktsFromParent -= incrementInTakts;
     if (id != rootId) nodes[id].positionInTaktsFromParent += incrementInTakts;
+    // // children are compensated, so only the moved node changes its absolute position (or everything but the root, if the root moved)
+    if (id == rootId) {
+        invalidateAllAbsoluteData();
+        markAllDirty();
+    }
+    else {
+        invalidateAbsoluteData(id);
+        markDirty(id);
+    }
+    ++revision;
     return 0;
 }
 int ScoreFile::changeNodeDuration(int id, int newDuration) {
-    if (id >= nodes.size()) return 1;
+    if (!isNode(id)) return 1;
     nodes[id].durationInTakts = newDuration;
+    markDirty(id);
+    ++revision;
+    return 0;
+}
+int ScoreFile::changeParam(const std::string& name, double value) {
+    params[name] = value;
     return 0;
 }
 
 // // CREATE/DELETE
-int ScoreFile::createNode(int parentId, discrete::Monzo ratioFromParent, int positionInTaktsFromParent, int durationInTakts) {
-    if (parentId >= nodes.size()) return 1;
-    int id = nodes.size();
-    nodes.emplace_back();
-    Node& n = nodes.back();
+int ScoreFile::createNode(int parentId, discrete::Monzo ratioFromParent, int positionInTaktsFromParent, int durationInTakts, int* createdId) {
+    if (!isNode(parentId)) return 1;
+    int id;
+    if (freeIds.empty()) {
+        id = nodes.size();
+        nodes.emplace_back();
+        generations.push_back(0);
+        absoluteCache.emplace_back();
+        childLists.emplace_back();
+    }
+    else {
+        id = freeIds.back();
+        freeIds.pop_back();
+        absoluteCache[id].isValid = false;
+    }
+    Node& n = nodes[id];
     n.id = id;
     n.parentId = parentId;
-    n.ratioFromParent = ratioFromParent;
+    setRatioFromParent(n, ratioFromParent);
     n.positionInTaktsFromParent = positionInTaktsFromParent;
     n.durationInTakts = durationInTakts;
+    ++numberOfNodes;
+    addChild(parentId, id);
+    if (createdId) *createdId = id;
+    markDirty(id);
+    ++revision;
     return 0;
 }
 int ScoreFile::deleteNode(int id) {
-    if (id >= nodes.size()) return 1;
+    if (!isNode(id)) return 1;
     if (id == rootId) return 1;
-    int newParentId = nodes[id].parentId;
-    for (Node& n : nodes) {
-        if (n.parentId == id) changeParent(n.id, newParentId);
+    Node& d = nodes[id];
+    // // the children hang from the parent of the deleted node, keeping their absolute ratio and position, so the cache stays valid
+    for (int k : childLists[id]) {
+        Node& c = nodes[k];
+        c.parentId = d.parentId;
+        setRatioFromParent(c, d.ratioFromParent * c.ratioFromParent);
+        c.positionInTaktsFromParent += d.positionInTaktsFromParent;
+        markDirty(c.id);
     }
+    markDirty(id);
+    // // so do they in the index: merged into the parent's list, which stays sorted. O(children of both)
+    std::vector<int>& siblings = childLists[d.parentId];
+    siblings.erase(std::lower_bound(siblings.begin(), siblings.end(), id));
+    const int nSiblings = siblings.size();
+    siblings.insert(siblings.end(), childLists[id].begin(), childLists[id].end());
+    std::inplace_merge(siblings.begin(), siblings.begin() + nSiblings, siblings.end());
+    childLists[id].clear();
     
-    int backId = nodes.back().id;
-    for (Node& n : nodes) {
-        if (n.parentId == backId) n.parentId = id;
-    }
-    if (rootId == backId) rootId = id;
-    nodes[backId].id = id;
-    nodes[id] = nodes.back();
-    nodes.pop_back();
+    d.id = Node::NULL_ID;
+    d.parentId = Node::NULL_ID;
+    ++generations[id];
+    freeIds.push_back(id);
+    --numberOfNodes;
+    ++revision;
     return 0;
 }
 
 std::vector<int> ScoreFile::getOrderedNodeIds() const {
     std::vector<int> result;
-    result.reserve(nodes.size());
-    std::list<int> oldQue, newQue;
-    oldQue.push_back(rootId);
-    while (!oldQue.empty()) {
-        for (int i : oldQue) result.push_back(i);
-        for (int j = 0; j < nodes.size(); ++j) {
-            for (int i : oldQue) {
-                if (nodes[j].parentId == i) {
-                    newQue.push_back(j);
-                    break;
-                }
-            }
-        }
-        oldQue = newQue;
-        newQue.clear();
+    result.reserve(numberOfNodes);
+    collectSubtree(rootId, result);
+    return result;
+}
+
+// // ABSOLUTE DATA CACHE
+const ScoreFile::AbsoluteData& ScoreFile::getAbsoluteData(int id) const {
+    if (absoluteCache[id].isValid) return absoluteCache[id];
+    // // climb until a node with valid data (or the root) is found, then fill the path downwards
+    absoluteCachePath.clear();
+    int i = id;
+    while (i != rootId && !absoluteCache[i].isValid) {
+        absoluteCachePath.push_back(i);
+        i = nodes[i].parentId;
     }
+    if (i == rootId && !absoluteCache[i].isValid) {
+        absoluteCache[i].smallRatio = SmallMonzo{};
+        absoluteCache[i].isSmallRatio = true;
+        absoluteCache[i].positionInTakts = 0;
+        absoluteCache[i].isValid = true;
+    }
+    for (int k = (int)absoluteCachePath.size()-1; k >= 0; --k) {
+        const int j = absoluteCachePath[k];
+        const AbsoluteData& p = absoluteCache[nodes[j].parentId];
+        AbsoluteData& a = absoluteCache[j];
+        a.isSmallRatio = p.isSmallRatio && nodes[j].isSmallRatio && 0 == SmallMonzo::multiply(p.smallRatio, nodes[j].smallRatioFromParent, a.smallRatio);
+        if (!a.isSmallRatio) a.ratio = p.getRatio() * nodes[j].ratioFromParent;
+        a.positionInTakts = p.positionInTakts + nodes[j].positionInTaktsFromParent;
+        a.isValid = true;
+    }
+    return absoluteCache[id];
+}
+discrete::Monzo ScoreFile::AbsoluteData::getRatio() const {
+    return isSmallRatio ? smallRatio.toMonzo() : ratio;
+}
+int ScoreFile::getRelativeSmallRatio(int fromId, int toId, SmallMonzo& result) const {
+    const AbsoluteData& to = getAbsoluteData(toId);
+    const AbsoluteData& from = getAbsoluteData(fromId);
+    if (!to.isSmallRatio || !from.isSmallRatio) return 1;
+    return SmallMonzo::divide(to.smallRatio, from.smallRatio, result);
+}
+void ScoreFile::setRatioFromParent(Node& n, const discrete::Monzo& ratio) {
+    n.ratioFromParent = ratio;
+    n.isSmallRatio = 0 == SmallMonzo::fromMonzo(ratio, n.smallRatioFromParent);
+}
+void ScoreFile::invalidateAbsoluteData(int id) {
+    absoluteCache[id].isValid = false;
+}
+void ScoreFile::invalidateAbsoluteDataOfSubtree(int id) {
+    collectSubtree(id, absoluteCachePath);
+    for (int i : absoluteCachePath) absoluteCache[i].isValid = false;
+}
+void ScoreFile::invalidateAllAbsoluteData() {
+    absoluteCache.assign(nodes.size(), AbsoluteData{});
+}
+
+// // SLOTS
+void ScoreFile::resetSlots() {
+    numberOfNodes = nodes.size();
+    generations.assign(nodes.size(), 0);
+    freeIds.clear();
+    invalidateAllAbsoluteData();
+    rebuildChildIndex();
+    markAllDirty();
+}
+std::vector<int> ScoreFile::getFileIds() const {
+    std::vector<int> fileIds(nodes.size(), Node::NULL_ID);
+    int nextId = 0;
+    for (const Node& n : nodes) {
+        if (n.id != Node::NULL_ID) fileIds[n.id] = nextId++;
+    }
+    return fileIds;
+}
+
+// // DIRTY NODES
+void ScoreFile::markDirty(int id) {
+    if (areAllNodesDirty) return;
+    // // nobody may be taking them (offline renders, conversions): past one entry per slot, rereading everything is cheaper anyway
+    if (dirtyNodeIds.size() >= nodes.size()) {
+        markAllDirty();
+        return;
+    }
+    dirtyNodeIds.push_back(id);
+}
+void ScoreFile::markAllDirty() {
+    areAllNodesDirty = true;
+    dirtyNodeIds.clear();
+}
+bool ScoreFile::takeDirtyNodeIds(std::vector<int>& ids) {
+    ids.swap(dirtyNodeIds);
+    dirtyNodeIds.clear();
+    const bool result = areAllNodesDirty;
+    areAllNodesDirty = false;
+    if (result) ids.clear();
     return result;
+}
+
+// // CHILD INDEX
+void ScoreFile::rebuildChildIndex() {
+    // // nodes are visited in ascending id order, so every list comes out sorted
+    childLists.assign(nodes.size(), {});
+    for (const Node& n : nodes) {
+        if (n.id != Node::NULL_ID && n.parentId != Node::NULL_ID) childLists[n.parentId].push_back(n.id);
+    }
+}
+void ScoreFile::addChild(int parentId, int id) {
+    std::vector<int>& c = childLists[parentId];
+    c.insert(std::lower_bound(c.begin(), c.end(), id), id);
+}
+void ScoreFile::removeChild(int parentId, int id) {
+    std::vector<int>& c = childLists[parentId];
+    auto it = std::lower_bound(c.begin(), c.end(), id);
+    if (it != c.end() && *it == id) c.erase(it);
+}
+void ScoreFile::collectSubtree(int id, std::vector<int>& result) const {
+    // // breadth-first search, the result itself is the queue
+    result.clear();
+    result.push_back(id);
+    for (int q = 0; q < result.size(); ++q) {
+        const int i = result[q];
+        result.insert(result.end(), childLists[i].begin(), childLists[i].end());
+    }
 }
\ No newline at end of file
@@ -2,37 +2,83 @@
 #define SCORE_FILE_H
 
 #include <vector>
+#include <map>
+#include <string>
 
 #include "../external/json/single_include/nlohmann/json.hpp"
 #include "../external/discrete/primes.hpp"
+#include "SmallMonzo.hpp"
 
 struct ScoreFile {
     struct Node {
         inline static constexpr int NULL_ID = -1;
-        int id;
+        int id; // // NULL_ID for deleted nodes whose slot awaits reuse
         int parentId;
         discrete::Monzo ratioFromParent;
+        SmallMonzo smallRatioFromParent; // // ratioFromParent, if isSmallRatio. Kept in step by setRatioFromParent
+        bool isSmallRatio = false;
         int positionInTaktsFromParent;
         int durationInTakts;
     };
     
     int createBlank();
-    int readFromDisk(const char* path);
-    int writeToDisk(const char* path) const;
+    int readFromDisk(const char* path); // // json or binary, detected from the contents of the file
+    int writeToDisk(const char* path) const; // // binary if the path ends with binaryExtension, json otherwise. Writes a temporary file and renames it over path
+    inline static const std::string binaryExtension = ".jui";
+    static bool isBinaryPath(const std::string& path);
+    
+    // // What writeToDisk stores, and nothing else: the live nodes in file order (ids are positions), as plain integers.
+    // // Cheap to take on the UI thread and self-contained, so another thread can write it while the score changes
+    struct Snapshot {
+        struct Record {
+            int parentId;
+            int ratioNumerator;
+            int ratioDenominator;
+            int positionInTaktsFromParent;
+            int durationInTakts;
+        };
+        int rootId = 0;
+        double rootFrequency = 0;
+        double taktDurationInSeconds = 0;
+        std::vector<Record> records;
+        std::map<std::string, double> params;
+        bool areRatiosInRange = true; // // false if a ratio does not fit the 32-bit fields of the files. Nothing is written then
+        int writeToDisk(const char* path) const; // // like ScoreFile::writeToDisk
+        
+    private:
+        int writeJsonToDisk(const char* path) const;
+        int writeBinaryToDisk(const char* path) const;
+    };
+    Snapshot getSnapshot() const;
+    
+    // // Nodes live in slots and keep their id for their whole life. The slot of a deleted node is reused by a later createNode,
+    // // so code that keeps an id across edits can keep a Handle instead and check it with isValid
+    struct Handle {
+        int id = Node::NULL_ID;
+        unsigned generation = 0;
+    };
+    Handle getHandle(int id) const;
+    bool isValid(Handle handle) const;
     
     // // GET
     int getNumberOfNodes() const;
+    int getNumberOfSlots() const; // // every id is smaller than this
+    bool isNode(int id) const;
     int getRootId() const;
     double getRootFrequency() const;
     double getTaktDurationInSeconds() const;
     int getParentId(int id) const;
+    const std::vector<int>& getChildIds(int id) const; // // in ascending order
     discrete::Monzo getRatioFromParent(int id) const;
     int getPositionInTaktsFromParent(int id) const;
     int getDurationInTakts(int id) const;
     discrete::Monzo getRelativeRatio(int fromId, int toId) const;
+    double getRelativeOctaves(int fromId, int toId) const; // // log2 of getRelativeRatio
     int getRelativePositionInTakts(int fromId, int toId) const;
     double getFrequency(int id) const;
     const ScoreFile::Node& getNode(int id) const;
+    const std::map<std::string, double>& getParams() const;
+    unsigned long long getRevision() const; // // increases with every change of the score (params are not counted)
     
     // // MODIFY
     int changeRoot(int newRootId);
@@ -42,18 +88,73 @@ struct ScoreFile {
     int changeRatio(int id, discrete::Monzo newRatio);
     int incrementPositionInTaktsFromParent(int id, int newPosition);
     int changeNodeDuration(int id, int newDuration);
+    int changeParam(const std::string& name, double value);
     
     // // CREATE/DELETE
-    int createNode(int parentId, discrete::Monzo ratioFromParent, int positionInTaktsFromParent, int durationInTakts);
+    int createNode(int parentId, discrete::Monzo ratioFromParent, int positionInTaktsFromParent, int durationInTakts, int* createdId = nullptr);
     int deleteNode(int id);
     
     std::vector<int> getOrderedNodeIds() const;
     
+    // // Mutators record the nodes whose absolute position, ratio, duration, parent ratio or existence they changed, so that
+    // // a view of the score (ScoreEditor) can reread only those. Returns true if every slot must be reread; otherwise ids
+    // // gets the changed ones, possibly repeated. Either way the record starts anew
+    bool takeDirtyNodeIds(std::vector<int>& ids);
+    
 private:
+    unsigned long long revision = 0;
     int rootId;
     double rootFrequency;
     double taktDurationInSeconds;
-    std::vector<Node> nodes;
+    std::vector<Node> nodes; // // slots, indexed by id
+    std::vector<unsigned> generations; // // increased every time the node in a slot is deleted
+    std::vector<int> freeIds;
+    int numberOfNodes = 0;
+    void resetSlots(); // // for freshly loaded, dense node vectors
+    static void setRatioFromParent(Node& n, const discrete::Monzo& ratio); // // every write of ratioFromParent goes through here
+    std::vector<int> getFileIds() const; // // dense numbering of the live nodes, used when writing to disk
+    std::map<std::string, double> params; // // free-form numeric settings stored next to the score (view, synth...)
+    
+    std::vector<int> dirtyNodeIds;
+    bool areAllNodesDirty = true;
+    void markDirty(int id);
+    void markAllDirty();
+    
+    struct JsonLoader; // // SAX handler used by readFromDisk
+    int readJsonFromDisk(const char* path);
+    int readBinaryFromDisk(const char* path);
+    static int checkTree(const std::vector<Node>& nodes, int rootId); // // 0 if the loaded nodes, indexed by id, form one tree hanging from rootId
+    static bool isFileRatio(long long numerator, long long denominator); // // whether both fit the 32-bit fields of the files and are positive
+    static int getFileRatio(const Node& n, int& numerator, int& denominator); // // returns 1 if isFileRatio does not hold
+    static int syncFile(const std::string& path); // // flushes the file to the disk, so a later rename cannot expose an empty file after a crash
+    static int replaceFile(const std::string& fromPath, const std::string& toPath);
+    
+    // // ratio and position of every node measured from the root, filled lazily. Ratios within the limit of SmallMonzo,
+    // // which are nearly all of them, never touch discrete::Monzo
+    struct AbsoluteData {
+        SmallMonzo smallRatio; // // the ratio, if isSmallRatio
+        bool isSmallRatio = false;
+        discrete::Monzo ratio; // // the ratio, otherwise
+        int positionInTakts;
+        bool isValid = false;
+        discrete::Monzo getRatio() const;
+    };
+    // // returns 1 if the ratio is not small, to be computed with getRelativeRatio
+    int getRelativeSmallRatio(int fromId, int toId, SmallMonzo& result) const;
+    mutable std::vector<AbsoluteData> absoluteCache;
+    mutable std::vector<int> absoluteCachePath;
+    const AbsoluteData& getAbsoluteData(int id) const;
+    void invalidateAbsoluteData(int id);
+    void invalidateAbsoluteDataOfSubtree(int id);
+    void invalidateAllAbsoluteData();
+    
+    // // children of every node, per slot, in ascending id order. Built in O(N) by the loaders; each mutator that
+    // // changes parent links then patches only the lists it touches, so the index is always valid
+    std::vector<std::vector<int>> childLists;
+    void rebuildChildIndex();
+    void addChild(int parentId, int id);
+    void removeChild(int parentId, int id);
+    void collectSubtree(int id, std::vector<int>& result) const;
 };
 
 #endif /* end of include guard: SCORE_FILE_H */
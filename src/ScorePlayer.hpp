@@ -2,10 +2,19 @@
 #define SCORE_PLAYER_H
 
 #include "../external/dsp/_dsp.h"
+#include "Wavetable.hpp"
 
 #include <cmath>
 #include <list>
+#include <vector>
 #include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <deque>
+#include <string>
+#include <chrono>
 
 #include <iostream>
 
@@ -31,25 +40,39 @@
 #include "C:/terminal_cpp/_STEMS/template_miniaudio/external/miniaudio-master/miniaudio.h"
 
 namespace ScorePlayer {
+struct Timeline;
+enum class OscillatorEngine;
 ///////////////// METHODS TO CALL /////////////////////
 ///////////////////////////////////////////////////////
 void initializeAudio();
 void closeAudio();
 void playFrequencies(const std::vector<double>& freqs);
 void stop(bool muteReverb);
+void setTimeline(std::unique_ptr<Timeline> timeline);
+void transportPlay(double fromTakts);
+void transportStop();
+void transportSeek(double takts);
+void transportLoop(bool isLooping, double fromTakts, double toTakts);
+void printStats(std::ostream& os);
+void resetStats();
+int findParam(const std::string& name);
+void setParam(int id, double value);
+double getParam(int id);
+void setOscillator(OscillatorEngine engine, WavetableBank::Timbre timbre);
 ////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////
     
-namespace audio_settings {	
-	inline constexpr int NCHANNELS = 2;
-	inline constexpr int SAMPLERATE = 1 * 44100;
-	inline constexpr int PERIOD_SIZE_MS = 10;
-	inline constexpr int NPERIODS = 4;
-	typedef short BITRES; // // bit resolution
-}
+// // What init asks the audio device for; a 0 lets the backend choose. init overwrites it with what the device
+// // actually runs at. Offline renders use sampleRate and nChannels
+struct AudioSettings {
+    int nChannels = 2; // // the synth is stereo: mono devices get the mix of both sides, further channels silence
+    int sampleRate = 44100;
+    double periodSizeInMilliseconds = 10;
+    int nPeriods = 4;
+    int maxVoices = 64; // // the notes the synth can sound at once, device and renders alike
+};
 
-static_assert (audio_settings::NCHANNELS == 2); // // for now, just 2 channels supported
-static double frame[audio_settings::NCHANNELS]; // // in stack. NCHANNELS is small
+AudioSettings audioSettings;
 
 struct NoteData {
     double frequency;
@@ -60,18 +83,189 @@ struct NoteData {
     }
 };
 
-std::vector<double> isolatedFreqs;
-std::vector<double> isolatedFreqs_waiting;
-std::atomic_flag isDataBeingUsed = ATOMIC_FLAG_INIT;
+// // Wait-free single-producer single-consumer ring buffer. Messages are written into preallocated slots,
+// // so neither side allocates or waits for the other
+template <typename T, int Capacity>
+struct SpscQueue {
+    static_assert((Capacity & (Capacity-1)) == 0, "Capacity must be a power of 2");
+    
+    // // producer: fill the slot returned by beginPush (nullptr if the queue is full), then publish it with endPush
+    T* beginPush() {
+        const unsigned w = writeIndex.load(std::memory_order_relaxed);
+        if (w - readIndex.load(std::memory_order_acquire) == Capacity) return nullptr;
+        return &slots[w & (Capacity-1)];
+    }
+    void endPush() {
+        writeIndex.store(writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    
+    // // consumer: front returns nullptr if the queue is empty. The slot stays valid until pop
+    const T* front() const {
+        const unsigned r = readIndex.load(std::memory_order_relaxed);
+        if (r == writeIndex.load(std::memory_order_acquire)) return nullptr;
+        return &slots[r & (Capacity-1)];
+    }
+    void pop() {
+        readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    
+private:
+    T slots[Capacity];
+    alignas(64) std::atomic<unsigned> writeIndex{0};
+    alignas(64) std::atomic<unsigned> readIndex{0};
+};
+
+inline constexpr int maxNotes = 128; // // per note set; the voices that play them are set at init
 
-namespace ScoreSynth {
-    using namespace dsp;
-    const int SR = audio_settings::SAMPLERATE;
-    const double DT = 1./(double)SR;
+struct NoteSet {
+    int nFrequencies = 0;
+    double frequencies[maxNotes];
+};
+
+// // The score compiled for the transport: every note as a note-on and a note-off event at a frame position.
+// // Frame 0 is takt 0 (the position of the root). The UI builds it and never changes it once sent
+struct Timeline {
+    struct Note {
+        long long startFrame;
+        long long endFrame;
+        double frequency;
+    };
+    struct Event {
+        long long frame;
+        double frequency;
+        bool isNoteOn;
+        int noteId; // // index of the note in notes, so that a note-off releases its own note and no other
+    };
     
-    Clock clock;
+    Timeline(double _framesPerTakt) : framesPerTakt{_framesPerTakt} {}
+    
+    void addNote(int positionInTakts, int durationInTakts, double frequency) {
+        long long start = taktsToFrame(positionInTakts);
+        long long end = taktsToFrame(positionInTakts + durationInTakts);
+        if (end <= start) return;
+        notes.push_back({start, end, frequency});
+    }
+    // // sorts the notes and builds the events. Call it once, after the last addNote
+    void finish() {
+        std::sort(notes.begin(), notes.end(), [](const Note& a, const Note& b) { return a.startFrame < b.startFrame; });
+        maxEndFrames.resize(notes.size());
+        events.clear();
+        events.reserve(2*notes.size());
+        for (int i = 0; i < notes.size(); ++i) {
+            maxEndFrames[i] = std::max(notes[i].endFrame, i > 0 ? maxEndFrames[i-1] : notes[i].endFrame);
+            events.push_back({notes[i].startFrame, notes[i].frequency, true, i});
+            events.push_back({notes[i].endFrame, notes[i].frequency, false, i});
+        }
+        // // at the same frame note-offs go first, so a repeated note is released before it starts again
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.frame != b.frame ? a.frame < b.frame : (!a.isNoteOn && b.isNoteOn);
+        });
+    }
+    
+    long long taktsToFrame(double takts) const { return std::llround(takts * framesPerTakt); }
+    double frameToTakts(long long frame) const { return framesPerTakt > 0 ? frame / framesPerTakt : 0; }
+    long long getStartFrame() const { return notes.empty() ? 0 : notes.front().startFrame; }
+    long long getEndFrame() const { return maxEndFrames.empty() ? 0 : maxEndFrames.back(); }
+    int getNoteId(const Note& n) const { return (int)(&n - notes.data()); }
+    
+    // // index of the first event at or after frame
+    int findEvent(long long frame) const {
+        return (int)(std::lower_bound(events.begin(), events.end(), frame, [](const Event& e, long long f) { return e.frame < f; }) - events.begin());
+    }
+    // // calls f(note) for every note sounding at frame that started before it
+    template <typename F>
+    void forEachNoteStartedBefore(long long frame, F f) const {
+        int i = (int)(std::lower_bound(notes.begin(), notes.end(), frame, [](const Note& n, long long fr) { return n.startFrame < fr; }) - notes.begin()) - 1;
+        for (; i >= 0 && maxEndFrames[i] > frame; --i) {
+            if (notes[i].endFrame > frame) f(notes[i]);
+        }
+    }
+    void getFrequenciesAt(long long frame, std::vector<double>& result) const {
+        result.clear();
+        forEachNoteStartedBefore(frame+1, [&](const Note& n) { result.push_back(n.frequency); });
+    }
+    
+    double framesPerTakt;
+    std::vector<Note> notes; // // sorted by start
+    std::vector<long long> maxEndFrames; // // greatest end of notes[0..i], bounds the backward scans
+    std::vector<Event> events;
+};
+
+// // the UI threads talk to the audio thread only through these messages
+struct Command {
+    enum class Type {
+        PlayNotes,
+        Stop,
+        SetTimeline,
+        TransportPlay,
+        TransportStop,
+        TransportSeek,
+        TransportLoop
+    };
+    Type type;
+    bool muteReverb;
+    NoteSet notes;
+    const Timeline* timeline;
+    double takts[2];
+    bool isLooping;
+};
+
+// // Multi-producer, single-consumer: the main and console threads both send commands. They take producerMutex around
+// // each send, which makes them one producer for the ring, so the commands of both keep the order of their sends.
+// // The audio thread, the only consumer, never takes the mutex and never waits
+using CommandQueue = SpscQueue<Command, 64>;
+CommandQueue commands;
+std::mutex producerMutex;
+
+// // LIVE PARAMETERS
+// // Unlike commands, parameters are not queued: any thread stores a target in an atomic at any time, and the audio
+// // thread reads the targets once per block and glides towards them, crossing the whole range in glideSeconds
+struct ParamInfo {
+    const char* name; // // also the name of the console command and of the param stored in the score
+    double minValue;
+    double maxValue;
+    double defaultValue;
+    double glideSeconds;
+    const char* description;
+};
+
+enum ParamId {
+    ReverbDecay,
+    ReverbMix,
+    MasterGain,
+    CutoffMultiplier,
+    nParams
+};
+
+inline constexpr ParamInfo paramInfos[nParams]{
+    {"rev_decay", 0., 1., 0.7, 0.5, "the decay time of the reverberation. Smaller values mean dryer sound"},
+    {"rev_mix", 0., 1., 0.7, 0.05, "the proportion of reverberated sound in the output"},
+    {"gain", 0., 2., 1., 0.05, "the master gain"},
+    {"lp_multiplier", 1., 20., 6., 0.05, "the cutoff of the low-pass of each note, as a multiple of its frequency"}
+};
+
+// // The notes are played either by a band-limited saw through a low-pass (the classic sound, which follows
+// // lp_multiplier) or by reading precomputed band-limited tables of the chosen timbre, which costs less per voice
+enum class OscillatorEngine {
+    SawLowpass,
+    Wavetable,
+    nEngines
+};
+inline constexpr const char* oscillatorEngineNames[(int)OscillatorEngine::nEngines]{"saw_lp", "wavetable"};
+
+// // The whole DSP chain: voices, transport and reverb. The audio device plays the instance synth; offline renders
+// // create their own instances, one per thread
+struct ScoreSynth {
+    using Double2 = dsp::Double2;
+    using Clock = dsp::Clock;
+    using Sawbl = dsp::Sawbl;
+    using Onepole_lp = dsp::Onepole_lp;
+    using Yafr2 = dsp::Yafr2;
+    static constexpr int defaultSampleRate = 44100;
+    int SR = defaultSampleRate;
+    double DT = 1./defaultSampleRate;
     
-    void Start() {}
+    Clock clock;
     
     struct Oscillator {
         Double2 y;
@@ -80,142 +274,718 @@ namespace ScoreSynth {
             saw();
             y += lp(saw.y).y;
         }
-        void freq(double f) {
-            saw.dy(DT * f);
-            lp.dy(DT * std::min(14000., f*6));
+        void freq(double f, double cutoffMultiplier, double dt) {
+            saw.dy(dt * f);
+            cutoff(f, cutoffMultiplier, dt);
+        }
+        void cutoff(double f, double cutoffMultiplier, double dt) {
+            lp.dy(dt * std::min(14000., f*cutoffMultiplier));
+        }
+        // // adds amp times the next n samples to the channels
+        void render(double amp, double* left, double* right, int n) {
+            for (int i = 0; i < n; ++i) {
+                (*this)();
+                left[i] += amp * y[0];
+                right[i] += amp * y[1];
+            }
         }
         Sawbl saw;
         Onepole_lp lp;
     };
-
-    std::vector<Oscillator> units = std::vector<Oscillator>(30); ////////////////////////////////////////////////
-    int nUsedUnits = 0;
-
+    
+    // // A voice fades towards its target amplitude on its own envelope. Voices keep sounding across note sets
+    // // that contain their frequency; a voice that is stolen fades out fast and then restarts at nextFrequency
+    struct Voice {
+        Oscillator osc;
+        WavetableOscillator wavetableOsc;
+        bool isWavetable = false; // // which of both oscillators plays, chosen when the voice starts
+        double frequency = 0;
+        double nextFrequency = 0; // // > 0 while the voice is being stolen
+        inline static constexpr int noNote = -1; // // the notes of PlayNotes, which are never released one by one
+        int noteId = noNote; // // the timeline note it plays
+        int nextNoteId = noNote; // // the one it plays after being stolen
+        double amp = 0;
+        double ampTarget = 0;
+        bool isActive = false; // // sounding or fading out
+        bool isMatched = false; // // scratch flag of applyNoteSet
+        unsigned long long startOrder = 0; // // of its current note among all the notes started, to find the oldest
+    };
+    unsigned long long nNotesStarted = 0;
+    
+    std::vector<Voice> voices; // // preallocated by Start, never resized while the device runs
+    
+    // // any thread may change them at any time; they apply to the notes started afterwards, so nothing clicks
+    std::atomic<OscillatorEngine> oscillatorEngine{OscillatorEngine::SawLowpass};
+    std::atomic<WavetableBank::Timbre> timbre{WavetableBank::Timbre::Saw};
+    WavetableBank wavetables; // // built by Start
+    
     enum class State {
-        None,
         Idle,
         Playing
     };
-    std::atomic<State> state[2]{ State::Idle, State::None }; // // state[0] is current state. state[1] is requested state. //////////////////// atomic ???????
+    std::atomic<State> state{State::Idle}; // // Playing while some voice sounds. Only the audio thread writes it
     
-    double gainCompensation;
-        
-    Yafr2 rev{SR, 0.7, 0.5};
+    double gainCompensation = 1; // // follows 1/(number of notes) smoothly
+    double gainCompensationTarget = 1;
+    double gainSmoothing = 1. - std::exp(-1./(defaultSampleRate*0.01));
     
-    double amp = 0;
-    double ampDy = 1./(SR*0.03);
+    Yafr2 rev{defaultSampleRate, 0.7, 0.5};
+    std::atomic<double> paramTargets[nParams]; // // written by any thread
+    double params[nParams]; // // the smoothed values, audio thread only
     
-    void applyNewFreqs() {
-        if (isDataBeingUsed.test_and_set(std::memory_order_acquire)) return;
-        isolatedFreqs = isolatedFreqs_waiting;
-        isDataBeingUsed.clear(std::memory_order_release);
-        state[0] = State::Playing;
-        state[1] = State::None;
-        nUsedUnits = isolatedFreqs.size();
-        for (int i = 0; i < nUsedUnits; ++i) units[i].freq(isolatedFreqs[i]);
-        gainCompensation = nUsedUnits == 0 ? 1. : 1./nUsedUnits;
-    }
+    double ampDy = 1./(defaultSampleRate*0.03);
+    double stealAmpDy = 1./(defaultSampleRate*0.003);
+    
+    int nActiveVoices = 0; // // after the last block
     
     bool muteReverb = false;
+    double reverbAmp = 1; // // fades out the reverb after a muting stop
     
-    Double2 y{0.,0.};
-    void Update(double* frame) {
-        
-        if (state[0] == State::Idle && state[1] == State::None) {
-            // // be idle
-        }
-        else if (state[0] == State::Idle && state[1] == State::Playing) {
-            applyNewFreqs();
-        }
-        else if (state[0] == State::Playing && state[1] == State::None) {
-            amp += ampDy;
-            if (amp > 1) amp = 1;
-        }
-        else if (state[0] == State::Playing && state[1] == State::Idle) {
-            amp -= ampDy;
-            if (amp <= 0) {
-                amp = 0;
-                state[0] = State::Idle;
-                state[1] = State::None;
-                if (muteReverb) rev.reset();
+    ScoreSynth() {
+        for (int id = 0; id < nParams; ++id) initParam(id, paramInfos[id].defaultValue);
+    }
+    
+    // // sets the value without gliding. Only while the audio thread is not running
+    void initParam(int id, double value) {
+        value = std::clamp(value, paramInfos[id].minValue, paramInfos[id].maxValue);
+        params[id] = value;
+        paramTargets[id].store(value, std::memory_order_relaxed);
+        if (id == ReverbDecay) rev.decay = value;
+    }
+    
+    // // lock-free, callable from any thread while the audio runs
+    void setParam(int id, double value) {
+        paramTargets[id].store(std::clamp(value, paramInfos[id].minValue, paramInfos[id].maxValue), std::memory_order_relaxed);
+    }
+    
+    double getParam(int id) const {
+        return paramTargets[id].load(std::memory_order_relaxed);
+    }
+    
+    // // the value a parameter reaches at the end of a block of nFrames
+    double glideParam(int id, int nFrames) const {
+        const ParamInfo& info = paramInfos[id];
+        const double maxDelta = (info.maxValue - info.minValue) * nFrames / (SR * info.glideSeconds);
+        return params[id] + std::clamp(paramTargets[id].load(std::memory_order_relaxed) - params[id], -maxDelta, maxDelta);
+    }
+    
+    // // every coefficient that depends on the sample rate; the reverb is built anew. Only while the audio thread is not running
+    void setSampleRate(int sampleRate) {
+        SR = sampleRate;
+        DT = 1./SR;
+        gainSmoothing = 1. - std::exp(-1./(SR*0.01));
+        ampDy = 1./(SR*0.03);
+        stealAmpDy = 1./(SR*0.003);
+        rev = Yafr2{SR, params[ReverbDecay], 0.5};
+    }
+    
+    void Start(int maxVoices, int sampleRate) {
+        setSampleRate(sampleRate);
+        wavetables.build(SR);
+        voices.assign(maxVoices, Voice{});
+        steadyWavetableVoices.reserve(maxVoices);
+        state = State::Idle;
+    }
+    
+    static bool isSameFrequency(double f1, double f2) {
+        return std::abs(f1 - f2) <= 1e-9 * std::max(f1, f2);
+    }
+    
+    // // called from the audio thread
+    void startVoice(Voice& v, double frequency, int noteId) {
+        v.isWavetable = oscillatorEngine.load(std::memory_order_relaxed) == OscillatorEngine::Wavetable;
+        restartVoice(v, frequency, noteId);
+    }
+    
+    // // keeps the oscillator the voice had: renderVoice restarts stolen voices in the middle of a block
+    void restartVoice(Voice& v, double frequency, int noteId) {
+        v.frequency = frequency;
+        v.nextFrequency = 0;
+        v.noteId = noteId;
+        v.startOrder = ++nNotesStarted;
+        if (v.isWavetable) v.wavetableOsc.freq(wavetables, timbre.load(std::memory_order_relaxed), frequency, DT);
+        else v.osc.freq(frequency, params[CutoffMultiplier], DT);
+        v.ampTarget = 1;
+        v.isActive = true;
+    }
+    
+    // // a free voice, else the quietest one fading out, else the one holding the oldest note. Voices already taken by
+    // // the current note set, or being stolen, are never chosen: nullptr if those are all there are
+    Voice* findVoiceToStart() {
+        Voice* quietest = nullptr;
+        Voice* oldest = nullptr;
+        for (Voice& v : voices) {
+            if (!v.isActive) return &v;
+            if (v.isMatched || v.nextFrequency > 0) continue;
+            if (v.ampTarget > 0) {
+                if (!oldest || v.startOrder < oldest->startOrder) oldest = &v;
             }
+            else if (!quietest || v.amp < quietest->amp) quietest = &v;
         }
-        else if (state[0] == State::Playing && state[1] == State::Playing) {
-            amp -= ampDy;
-            if (amp <= 0) {
-                amp = 0;
-                applyNewFreqs();
-            }
+        return quietest ? quietest : oldest;
+    }
+    
+    void startOrStealVoice(Voice& v, double frequency, int noteId) {
+        if (!v.isActive || v.amp <= 0) {
+            v.amp = 0;
+            startVoice(v, frequency, noteId);
         }
         else {
-            std::cerr << "synth states wtf\n";
-            throw "err";
+            v.ampTarget = 0;
+            v.nextFrequency = frequency;
+            v.nextNoteId = noteId;
         }
-        
-        y.null();
-        if (state[0] == State::Playing) {
-            for (int u = 0; u < nUsedUnits; ++u) {
-                units[u]();
-                y += units[u].y;
+    }
+    
+    // // called from the audio thread
+    void releaseAllVoices() {
+        for (Voice& v : voices) {
+            v.ampTarget = 0;
+            v.nextFrequency = 0;
+        }
+    }
+    
+    // // TRANSPORT. Plays the timeline by turning its events into note-ons and note-offs at their exact frames
+    const Timeline* timeline = nullptr;
+    std::atomic<const Timeline*> timelineInUse{nullptr}; // // tells the UI which timelines it may delete
+    bool isTransportRunning = false;
+    long long transportFrame = 0;
+    int nextEventId = 0;
+    bool isLooping = false;
+    double loopTakts[2]{0, 0};
+    int nHeldNotes = 0;
+    std::atomic<bool> isTransportPlaying{false}; // // published for the UI after every block
+    std::atomic<double> transportPositionInTakts{0};
+    
+    void updateTransportGain() {
+        gainCompensationTarget = nHeldNotes <= 0 ? 1. : 1./nHeldNotes;
+    }
+    
+    // // with isResuming, a voice fading out on the same frequency comes back without a new attack
+    // // (used when relocating, so that the notes that keep sounding do not restart)
+    void noteOn(double frequency, int noteId, bool isResuming = false) {
+        ++nHeldNotes;
+        updateTransportGain();
+        if (isResuming) {
+            for (Voice& v : voices) {
+                if (v.isActive && v.ampTarget == 0 && v.nextFrequency <= 0 && isSameFrequency(v.frequency, frequency)) {
+                    v.ampTarget = 1;
+                    v.noteId = noteId;
+                    return;
+                }
             }
-            y *= gainCompensation;
-            y *= amp;
-            rev.x += y;
         }
+        if (Voice* v = findVoiceToStart()) startOrStealVoice(*v, frequency, noteId);
+    }
+    
+    // // releases the voice of the note, if it still has one: the voice of a stolen note plays another note by now
+    void noteOff(int noteId) {
+        nHeldNotes = std::max(nHeldNotes-1, 0);
+        updateTransportGain();
+        for (Voice& v : voices) {
+            if (!v.isActive) continue;
+            if (v.nextFrequency > 0 && v.nextNoteId == noteId) { // // released before it could start
+                v.nextFrequency = 0;
+                return;
+            }
+            if (v.nextFrequency <= 0 && v.ampTarget > 0 && v.noteId == noteId) {
+                v.ampTarget = 0;
+                return;
+            }
+        }
+    }
+    
+    // // moves the transport to frame and starts the notes that sound across it
+    void locateTransport(long long frame) {
+        releaseAllVoices();
+        nHeldNotes = 0;
+        transportFrame = frame;
+        if (!timeline) return;
+        nextEventId = timeline->findEvent(frame);
+        timeline->forEachNoteStartedBefore(frame, [this](const Timeline::Note& n) { noteOn(n.frequency, timeline->getNoteId(n), true); });
+    }
+    
+    void stopTransport() {
+        if (!isTransportRunning) return;
+        isTransportRunning = false;
+        releaseAllVoices();
+        nHeldNotes = 0;
+    }
+    
+    // // applies the events due at the transport position and returns how many frames can be rendered
+    // // before the next one (at most maxFrames)
+    int advanceTransport(int maxFrames) {
+        long long loopStart = 0, loopEnd = 0;
+        const bool isLoopValid = isLooping && (loopStart = timeline->taktsToFrame(loopTakts[0])) < (loopEnd = timeline->taktsToFrame(loopTakts[1]));
+        if (isLoopValid && transportFrame >= loopEnd) locateTransport(loopStart);
         
-        rev();
-        double revMix = 0.7;
-        y = (1-revMix)*y + revMix*(muteReverb ? amp : 1)*rev.y;
-        
-        for (int c = 0; c < 2; ++c) {
-            if (y[c] < -1) y[c] = -1;
-            if (y[c] > 1) y[c] = 1;
+        const std::vector<Timeline::Event>& events = timeline->events;
+        while (nextEventId < events.size() && events[nextEventId].frame <= transportFrame) {
+            const Timeline::Event& e = events[nextEventId++];
+            if (e.isNoteOn) noteOn(e.frequency, e.noteId);
+            else noteOff(e.noteId);
+        }
+        if (!isLoopValid && nextEventId == events.size()) { // // the end of the score
+            isTransportRunning = false;
+            nHeldNotes = 0;
+            return maxFrames;
         }
-        frame[0] = y[0]; frame[1] = y[1];
+        long long limit = nextEventId < events.size() ? events[nextEventId].frame : loopEnd;
+        if (isLoopValid) limit = std::min(limit, loopEnd);
+        return (int)std::min<long long>(maxFrames, limit - transportFrame);
     }
     
-    void requestIsolatedNotes() {
-        state[1] = State::Playing;
+    // // called from the audio thread
+    void applyNoteSet(const NoteSet& notes) {
         muteReverb = false;
-        return;
+        reverbAmp = 1;
+        stopTransport();
+        for (Voice& v : voices) v.isMatched = false;
+        
+        // // voices already on one of the frequencies keep sounding (or come back from their fade-out)
+        bool isNoteMatched[maxNotes]{};
+        for (int n = 0; n < notes.nFrequencies; ++n) {
+            for (Voice& v : voices) {
+                if (v.isMatched || !v.isActive) continue;
+                const double f = v.nextFrequency > 0 ? v.nextFrequency : v.frequency;
+                if (!isSameFrequency(f, notes.frequencies[n])) continue;
+                v.isMatched = true;
+                isNoteMatched[n] = true;
+                if (v.nextFrequency <= 0) v.ampTarget = 1;
+                break;
+            }
+        }
+        // // the rest fade out
+        for (Voice& v : voices) {
+            if (v.isActive && !v.isMatched) {
+                v.ampTarget = 0;
+                v.nextFrequency = 0;
+            }
+        }
+        // // new frequencies take a free voice, or steal the quietest fading one
+        for (int n = 0; n < notes.nFrequencies; ++n) {
+            if (isNoteMatched[n]) continue;
+            Voice* chosen = findVoiceToStart();
+            if (!chosen) break; // // more notes than voices
+            chosen->isMatched = true;
+            startOrStealVoice(*chosen, notes.frequencies[n], Voice::noNote);
+        }
+        for (Voice& v : voices) v.isMatched = false;
+        gainCompensationTarget = notes.nFrequencies == 0 ? 1. : 1./notes.nFrequencies;
     }
     
-    void requestStop(bool _muteReverb) {
+    // // called from the audio thread
+    void applyStop(bool _muteReverb) {
+        stopTransport();
         muteReverb = _muteReverb;
-        if (state[0] == State::Idle) state[1] = State::None;
-        else state[1] = State::Idle;
-        return;
+        releaseAllVoices();
     }
-} // // namespace ScoreSynth
+    
+    // // applies, in order, every command sent since the last audio block
+    void processCommands(CommandQueue& queue) {
+        while (const Command* command = queue.front()) {
+            process(*command);
+            queue.pop();
+        }
+    }
+    
+    void process(const Command& command) {
+        switch (command.type) {
+            case Command::Type::PlayNotes:
+                applyNoteSet(command.notes);
+                break;
+            case Command::Type::Stop:
+                applyStop(command.muteReverb);
+                break;
+            case Command::Type::SetTimeline:
+                timeline = command.timeline;
+                timelineInUse.store(timeline, std::memory_order_release);
+                if (isTransportRunning) locateTransport(transportFrame);
+                break;
+            case Command::Type::TransportPlay:
+                if (!timeline) break;
+                muteReverb = false;
+                reverbAmp = 1;
+                isTransportRunning = true;
+                locateTransport(timeline->taktsToFrame(command.takts[0]));
+                break;
+            case Command::Type::TransportStop:
+                stopTransport();
+                break;
+            case Command::Type::TransportSeek:
+                if (!timeline) break;
+                if (isTransportRunning) locateTransport(timeline->taktsToFrame(command.takts[0]));
+                else transportFrame = timeline->taktsToFrame(command.takts[0]);
+                break;
+            case Command::Type::TransportLoop:
+                isLooping = command.isLooping;
+                loopTakts[0] = command.takts[0];
+                loopTakts[1] = command.takts[1];
+                break;
+        }
+    }
+    
+    // // Render works on blocks of at most maxBlockSize frames. Each voice runs over the whole block, its envelope
+    // // computed sample by sample, and is summed into channel-major dry buffers (the steady wavetable voices all at
+    // // once, by renderWavetableVoices); then gain, reverb and clamping
+    static constexpr int maxBlockSize = 256;
+    double dry[2][maxBlockSize];
+    
+    // // returns true if the voice is still active after the block. voiceOsc is the oscillator of the voice that plays
+    template <typename Osc>
+    bool renderVoice(Voice& v, Osc& voiceOsc, int nFrames) {
+        Osc osc = voiceOsc; // // a local copy cannot alias the buffers, so its state stays in registers
+        double amp = v.amp;
+        int i = 0;
+        while (i < nFrames) {
+            if (amp == v.ampTarget) { // // steady part of the envelope
+                if (amp == 0) break;
+                osc.render(amp, dry[0]+i, dry[1]+i, nFrames-i);
+                break;
+            }
+            const double dy = v.nextFrequency > 0 ? stealAmpDy : ampDy;
+            amp = v.ampTarget > amp ? std::min(amp + dy, v.ampTarget) : std::max(amp - dy, v.ampTarget);
+            if (amp == 0 && v.nextFrequency > 0) { // // the stolen voice is silent now, it restarts at its new frequency
+                voiceOsc = osc;
+                restartVoice(v, v.nextFrequency, v.nextNoteId);
+                osc = voiceOsc;
+            }
+            osc();
+            dry[0][i] += amp * osc.y[0];
+            dry[1][i] += amp * osc.y[1];
+            ++i;
+        }
+        voiceOsc = osc;
+        v.amp = amp;
+        if (amp == 0 && v.ampTarget == 0) v.isActive = false;
+        return v.isActive;
+    }
+    
+    // // The wavetable voices that hold their amplitude over the whole block, which is nearly all of them nearly always,
+    // // are rendered together by one kernel from structure-of-arrays copies of their state: phases, increments,
+    // // tables and amplitudes side by side. They are mono, so they are summed into one buffer that both channels take
+    struct WavetableVoices {
+        std::vector<Voice*> voices;
+        std::vector<uint32_t> phases;
+        std::vector<uint32_t> dphases;
+        std::vector<const float*> tables;
+        std::vector<double> amps;
+        void reserve(int n) {
+            voices.reserve(n);
+            phases.reserve(n);
+            dphases.reserve(n);
+            tables.reserve(n);
+            amps.reserve(n);
+        }
+        void clear() {
+            voices.clear();
+            phases.clear();
+            dphases.clear();
+            tables.clear();
+            amps.clear();
+        }
+        void push_back(Voice& v) {
+            voices.push_back(&v);
+            phases.push_back(v.wavetableOsc.phase);
+            dphases.push_back(v.wavetableOsc.dphase);
+            tables.push_back(v.wavetableOsc.table);
+            amps.push_back(v.amp);
+        }
+    };
+    WavetableVoices steadyWavetableVoices; // // reserved by Start for every voice, so the audio thread never allocates
+    double mono[maxBlockSize];
+    
+    // // Chunks of frames, and within each chunk voice after voice: the phases of a voice over the chunk come from a
+    // // loop without dependencies between samples, which the compiler vectorizes, then the table is read into the
+    // // mono chunk, which stays in cache while every voice adds to it
+    void renderWavetableVoices(int nFrames) {
+        WavetableVoices& s = steadyWavetableVoices;
+        const int nVoices = s.voices.size();
+        constexpr int chunkSize = 64;
+        uint32_t chunkPhases[chunkSize];
+        std::fill(mono, mono+nFrames, 0.);
+        for (int i0 = 0; i0 < nFrames; i0 += chunkSize) {
+            const int m = std::min(chunkSize, nFrames - i0);
+            for (int k = 0; k < nVoices; ++k) {
+                const uint32_t phase = s.phases[k], dphase = s.dphases[k];
+                for (int i = 0; i < m; ++i) chunkPhases[i] = phase + (uint32_t)(i+1) * dphase;
+                s.phases[k] = phase + (uint32_t)m * dphase;
+                const float* table = s.tables[k];
+                const double amp = s.amps[k];
+                for (int i = 0; i < m; ++i) mono[i0+i] += amp * WavetableOscillator::read(table, chunkPhases[i]);
+            }
+        }
+        for (int i = 0; i < nFrames; ++i) {
+            dry[0][i] += mono[i];
+            dry[1][i] += mono[i];
+        }
+        for (int k = 0; k < nVoices; ++k) {
+            WavetableOscillator& osc = s.voices[k]->wavetableOsc;
+            osc.phase = s.phases[k];
+            osc.y[0] = osc.y[1] = WavetableOscillator::read(osc.table, osc.phase);
+        }
+    }
+    
+    // // the cutoff moves once per block, the other parameters sample by sample
+    void renderBlock(float* out, int nFrames) {
+        const double cutoffMultiplier = glideParam(CutoffMultiplier, nFrames);
+        if (cutoffMultiplier != params[CutoffMultiplier]) {
+            params[CutoffMultiplier] = cutoffMultiplier;
+            for (Voice& v : voices) {
+                if (v.isActive && !v.isWavetable) v.osc.cutoff(v.frequency, cutoffMultiplier, DT);
+            }
+        }
+        
+        std::fill(dry[0], dry[0]+nFrames, 0.);
+        std::fill(dry[1], dry[1]+nFrames, 0.);
+        int nVoicesActive = 0;
+        steadyWavetableVoices.clear();
+        for (Voice& v : voices) {
+            if (!v.isActive) continue;
+            if (v.isWavetable && v.amp == v.ampTarget && v.amp > 0) {
+                steadyWavetableVoices.push_back(v);
+                ++nVoicesActive;
+                continue;
+            }
+            nVoicesActive += v.isWavetable ? renderVoice(v, v.wavetableOsc, nFrames) : renderVoice(v, v.osc, nFrames);
+        }
+        if (!steadyWavetableVoices.voices.empty()) renderWavetableVoices(nFrames);
+        nActiveVoices = nVoicesActive;
+        
+        double decay = params[ReverbDecay];
+        double mix = params[ReverbMix];
+        double gain = params[MasterGain];
+        const double decayEnd = glideParam(ReverbDecay, nFrames);
+        const double mixEnd = glideParam(ReverbMix, nFrames);
+        const double gainEnd = glideParam(MasterGain, nFrames);
+        const double decayStep = (decayEnd - decay) / nFrames;
+        const double mixStep = (mixEnd - mix) / nFrames;
+        const double gainStep = (gainEnd - gain) / nFrames;
+        for (int i = 0; i < nFrames; ++i) {
+            gainCompensation += (gainCompensationTarget - gainCompensation) * gainSmoothing;
+            Double2 y{dry[0][i] * gainCompensation, dry[1][i] * gainCompensation};
+            decay += decayStep;
+            mix += mixStep;
+            gain += gainStep;
+            rev.decay = decay;
+            rev.x += y;
+            rev();
+            if (muteReverb && reverbAmp > 0) {
+                reverbAmp = std::max(reverbAmp - ampDy, 0.);
+                if (reverbAmp == 0) rev.reset();
+            }
+            y = gain*((1-mix)*y + mix*(muteReverb ? reverbAmp : 1)*rev.y);
+            for (int c = 0; c < 2; ++c) {
+                if (y[c] < -1) y[c] = -1;
+                if (y[c] > 1) y[c] = 1;
+                out[2*i+c] = (float)y[c];
+            }
+        }
+        params[ReverbDecay] = decayEnd;
+        params[ReverbMix] = mixEnd;
+        params[MasterGain] = gainEnd;
+        state = nVoicesActive > 0 ? State::Playing : State::Idle;
+    }
+    
+    // // writes nFrames interleaved stereo frames. While the transport runs, blocks are cut at its events
+    void Render(float* out, int nFrames) {
+        while (nFrames > 0) {
+            int n = std::min(nFrames, maxBlockSize);
+            if (isTransportRunning) n = advanceTransport(n);
+            renderBlock(out, n);
+            if (isTransportRunning) transportFrame += n;
+            out += 2*n;
+            nFrames -= n;
+        }
+        isTransportPlaying.store(isTransportRunning, std::memory_order_relaxed);
+        if (timeline) transportPositionInTakts.store(timeline->frameToTakts(transportFrame), std::memory_order_relaxed);
+    }
+    
+    float stereo[2*maxBlockSize];
+    
+    // // writes nFrames frames of nChannels interleaved channels: mono gets the mix of both sides, and the
+    // // channels beyond the second get silence
+    void Render(float* out, int nFrames, int nChannels) {
+        if (nChannels == 2) {
+            Render(out, nFrames);
+            return;
+        }
+        while (nFrames > 0) {
+            const int n = std::min(nFrames, maxBlockSize);
+            Render(stereo, n);
+            for (int i = 0; i < n; ++i) {
+                float* frame = out + nChannels*i;
+                if (nChannels == 1) {
+                    frame[0] = 0.5f*(stereo[2*i] + stereo[2*i+1]);
+                    continue;
+                }
+                frame[0] = stereo[2*i];
+                frame[1] = stereo[2*i+1];
+                std::fill(frame+2, frame+nChannels, 0.f);
+            }
+            out += nChannels*n;
+            nFrames -= n;
+        }
+    }
+};
+
+ScoreSynth synth; // // played by the audio device
+
+// // AUDIO STATS
+// // Only the audio callback writes them, any thread reads them. Each field is a relaxed atomic, so a reader may
+// // get a snapshot torn across fields, which is fine for monitoring. Resets are requested and done by the callback
+struct AudioStats {
+    using Clock = std::chrono::steady_clock;
+    // // set by configure before the device starts
+    int sampleRate = ScoreSynth::defaultSampleRate;
+    double periodSeconds = 0;
+    double bufferSeconds = 0;
+    int nPeriods = 0;
+    static constexpr double loadSmoothingSeconds = 1.;
+    // // render times histogram, logarithmic: bin i > 0 ends at minBinSeconds * 2^(i/binsPerOctave), about 9% wider
+    // // than the previous one. Bin 0 holds what is faster than minBinSeconds, the last one what is slower than a second
+    static constexpr int binsPerOctave = 8;
+    static constexpr int nBins = 20*binsPerOctave + 1;
+    static constexpr double minBinSeconds = 1e-6;
+    
+    std::atomic<long long> nCallbacks{0};
+    std::atomic<long long> nFrames{0};
+    std::atomic<double> renderSeconds{0}; // // summed over all callbacks
+    std::atomic<double> maxRenderSeconds{0};
+    std::atomic<double> load{0}; // // render time over the duration of the audio rendered, smoothed
+    std::atomic<long long> nOverBudget{0}; // // callbacks that took longer than the audio they rendered lasts
+    std::atomic<long long> nUnderruns{0}; // // callbacks that came after the whole device buffer had been played
+    std::atomic<int> nVoices{0};
+    std::atomic<int> maxVoices{0};
+    std::atomic<long long> histogram[nBins]{};
+    std::atomic<bool> isResetRequested{false};
+    
+    Clock::time_point lastCallbackStart; // // audio thread only
+    bool hasLastCallback = false;
+    
+    template <typename T>
+    static void add(std::atomic<T>& counter, T x) {
+        counter.store(counter.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+    }
+    
+    void configure(const AudioSettings& settings) {
+        sampleRate = settings.sampleRate;
+        periodSeconds = settings.periodSizeInMilliseconds * 1e-3;
+        nPeriods = settings.nPeriods;
+        bufferSeconds = periodSeconds * nPeriods;
+    }
+    
+    // // called by the audio thread at the end of every callback
+    void record(Clock::time_point start, Clock::time_point end, int frameCount, int voiceCount) {
+        if (isResetRequested.load(std::memory_order_acquire)) {
+            nCallbacks = 0;
+            nFrames = 0;
+            renderSeconds = 0;
+            maxRenderSeconds = 0;
+            nOverBudget = 0;
+            nUnderruns = 0;
+            maxVoices = 0;
+            for (auto& bin : histogram) bin = 0;
+            isResetRequested.store(false, std::memory_order_release);
+        }
+        const double seconds = std::chrono::duration<double>(end - start).count();
+        const double audioSeconds = (double)frameCount / sampleRate;
+        add(nCallbacks, 1LL);
+        add(nFrames, (long long)frameCount);
+        add(renderSeconds, seconds);
+        if (seconds > maxRenderSeconds.load(std::memory_order_relaxed)) maxRenderSeconds.store(seconds, std::memory_order_relaxed);
+        if (seconds > audioSeconds) add(nOverBudget, 1LL);
+        if (hasLastCallback && std::chrono::duration<double>(start - lastCallbackStart).count() > bufferSeconds) add(nUnderruns, 1LL);
+        lastCallbackStart = start;
+        hasLastCallback = true;
+        if (audioSeconds > 0) {
+            const double a = 1. - std::exp(-audioSeconds / loadSmoothingSeconds);
+            load.store(load.load(std::memory_order_relaxed) + (seconds/audioSeconds - load.load(std::memory_order_relaxed)) * a, std::memory_order_relaxed);
+        }
+        const int bin = seconds < minBinSeconds ? 0 : 1 + (int)(binsPerOctave * std::log2(seconds / minBinSeconds));
+        add(histogram[std::min(bin, nBins-1)], 1LL);
+        nVoices.store(voiceCount, std::memory_order_relaxed);
+        if (voiceCount > maxVoices.load(std::memory_order_relaxed)) maxVoices.store(voiceCount, std::memory_order_relaxed);
+    }
+    
+    // // upper edge of the histogram bin holding the p-th fraction of the callbacks, at most the max; 0 if there are none
+    double getRenderSecondsPercentile(double p) const {
+        long long total = 0;
+        for (const auto& bin : histogram) total += bin.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        const long long rank = std::max(1LL, (long long)std::ceil(p * total));
+        long long count = 0;
+        for (int i = 0; i < nBins; ++i) {
+            count += histogram[i].load(std::memory_order_relaxed);
+            if (count >= rank) return std::min(minBinSeconds * std::exp2((double)i / binsPerOctave), maxRenderSeconds.load(std::memory_order_relaxed));
+        }
+        return maxRenderSeconds.load(std::memory_order_relaxed);
+    }
+    
+    void requestReset() {
+        isResetRequested.store(true, std::memory_order_release);
+    }
+    
+    void print(std::ostream& os) const {
+        const long long callbacks = nCallbacks.load(std::memory_order_relaxed);
+        const long long frames = nFrames.load(std::memory_order_relaxed);
+        const double audioSeconds = (double)frames / sampleRate;
+        os << ">> " << callbacks << " callbacks, " << audioSeconds << " s of audio at " << sampleRate << " Hz, period budget "
+            << periodSeconds*1e3 << " ms, " << nPeriods << " periods\n";
+        os << ">> DSP load: " << 100*load.load(std::memory_order_relaxed) << " % now, "
+            << (audioSeconds > 0 ? 100*renderSeconds.load(std::memory_order_relaxed)/audioSeconds : 0.) << " % on average\n";
+        os << ">> render time (ms): mean " << (callbacks > 0 ? 1e3*renderSeconds.load(std::memory_order_relaxed)/callbacks : 0.)
+            << ", p50 " << 1e3*getRenderSecondsPercentile(0.5)
+            << ", p99 " << 1e3*getRenderSecondsPercentile(0.99)
+            << ", p99.9 " << 1e3*getRenderSecondsPercentile(0.999)
+            << ", max " << 1e3*maxRenderSeconds.load(std::memory_order_relaxed) << '\n';
+        os << ">> over budget: " << nOverBudget.load(std::memory_order_relaxed)
+            << ", underruns: " << nUnderruns.load(std::memory_order_relaxed) << '\n';
+        os << ">> voices: " << nVoices.load(std::memory_order_relaxed) << " now, " << maxVoices.load(std::memory_order_relaxed)
+            << " at most, " << synth.voices.size() << " available\n";
+    }
+};
+
+AudioStats audioStats;
 
 void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
-	float *pt = (float *)pOutput;
-	for (int n = 0, n2 = 0, n2p1 = 1; n < frameCount; ++n, n2+=2, n2p1+=2) {
-        ScoreSynth::Update(frame);
-		pt[n2] = (float)frame[0];
-		pt[n2p1] = (float)frame[1];
-	}
+    const auto start = AudioStats::Clock::now();
+    synth.processCommands(commands);
+    synth.Render((float*)pOutput, (int)frameCount, audioSettings.nChannels);
+    audioStats.record(start, AudioStats::Clock::now(), (int)frameCount, synth.nActiveVoices);
 }
 
 ma_device_config config;
 ma_device device;
+// // opens the device with audioSettings, then updates them and the synth to what the backend granted
 void init() {
-    isolatedFreqs.reserve(30);
-    isolatedFreqs_waiting.reserve(30);
-    
-    ScoreSynth::Start();
-    
     config = ma_device_config_init(ma_device_type_playback);
     config.playback.format = ma_format_f32;
-    config.playback.channels = audio_settings::NCHANNELS;
-    config.sampleRate = audio_settings::SAMPLERATE;
+    config.playback.channels = (ma_uint32)audioSettings.nChannels;
+    config.sampleRate = (ma_uint32)audioSettings.sampleRate;
     config.dataCallback = data_callback;
-    config.periodSizeInMilliseconds = audio_settings::PERIOD_SIZE_MS;
-    config.periods = audio_settings::NPERIODS;
+    // // periods shorter than a millisecond, or fractional ones, need the size in frames, which needs a sample rate
+    if (audioSettings.sampleRate > 0) {
+        config.periodSizeInFrames = (ma_uint32)std::max(1L, std::lround(audioSettings.periodSizeInMilliseconds * 1e-3 * audioSettings.sampleRate));
+    }
+    else {
+        config.periodSizeInMilliseconds = (ma_uint32)std::max(1L, std::lround(audioSettings.periodSizeInMilliseconds));
+    }
+    config.periods = (ma_uint32)audioSettings.nPeriods;
     if (ma_device_init(NULL, &config, &device) != MA_SUCCESS) {
         std::cerr << "ERROR: Failed to initialize the device.\n";
         throw "err";
     }
+    
+    if (device.sampleRate > 0) audioSettings.sampleRate = (int)device.sampleRate;
+    if (device.playback.channels > 0) audioSettings.nChannels = (int)device.playback.channels;
+    if (device.playback.internalSampleRate > 0 && device.playback.internalPeriodSizeInFrames > 0) {
+        audioSettings.periodSizeInMilliseconds = 1e3 * device.playback.internalPeriodSizeInFrames / device.playback.internalSampleRate;
+    }
+    if (device.playback.internalPeriods > 0) audioSettings.nPeriods = (int)device.playback.internalPeriods;
+    synth.Start(audioSettings.maxVoices, audioSettings.sampleRate);
+    audioStats.configure(audioSettings);
+    
     ma_device_start(&device);
 }
 
@@ -223,15 +993,117 @@ void uninit() {
     ma_device_uninit(&device);
 }
 
+// // Call with producerMutex held. The queue only fills up if the audio callback stops draining it for 64 commands; then
+// // the sender spins until a slot frees, and the other producer waits on the mutex meanwhile
+Command& beginCommand() {
+    Command* command;
+    while (!(command = commands.beginPush())) std::this_thread::yield();
+    return *command;
+}
+
 void playFrequencies(const std::vector<double>& freqs) {
-    if (isDataBeingUsed.test_and_set(std::memory_order_acquire)) return;
-    isolatedFreqs_waiting = freqs;
-    isDataBeingUsed.clear(std::memory_order_release);
-    ScoreSynth::requestIsolatedNotes();
+    std::lock_guard<std::mutex> lock(producerMutex);
+    Command& command = beginCommand();
+    command.type = Command::Type::PlayNotes;
+    command.muteReverb = false;
+    command.notes.nFrequencies = std::min((int)freqs.size(), maxNotes);
+    for (int i = 0; i < command.notes.nFrequencies; ++i) command.notes.frequencies[i] = freqs[i];
+    commands.endPush();
 }
 
 void stop(bool muteReverb = false) {
-    ScoreSynth::requestStop(muteReverb);
+    std::lock_guard<std::mutex> lock(producerMutex);
+    Command& command = beginCommand();
+    command.type = Command::Type::Stop;
+    command.muteReverb = muteReverb;
+    command.notes.nFrequencies = 0;
+    commands.endPush();
+}
+
+// // every timeline sent, oldest first. Those before the one the audio thread uses are deleted on the next send
+std::deque<std::unique_ptr<Timeline>> sentTimelines;
+
+void setTimeline(std::unique_ptr<Timeline> timeline) {
+    std::lock_guard<std::mutex> lock(producerMutex);
+    const Timeline* inUse = synth.timelineInUse.load(std::memory_order_acquire);
+    for (int i = 0; i < sentTimelines.size(); ++i) {
+        if (sentTimelines[i].get() != inUse) continue;
+        sentTimelines.erase(sentTimelines.begin(), sentTimelines.begin()+i);
+        break;
+    }
+    Command& command = beginCommand();
+    command.type = Command::Type::SetTimeline;
+    command.timeline = timeline.get();
+    commands.endPush();
+    sentTimelines.push_back(std::move(timeline));
+}
+
+// // the last timeline sent, nullptr if none. Not thread-safe: only the thread that sends timelines may use it
+const Timeline* getLatestTimeline() {
+    return sentTimelines.empty() ? nullptr : sentTimelines.back().get();
+}
+
+void sendTransportCommand(Command::Type type, double fromTakts = 0, double toTakts = 0, bool isLooping = false) {
+    std::lock_guard<std::mutex> lock(producerMutex);
+    Command& command = beginCommand();
+    command.type = type;
+    command.takts[0] = fromTakts;
+    command.takts[1] = toTakts;
+    command.isLooping = isLooping;
+    commands.endPush();
+}
+
+void transportPlay(double fromTakts) {
+    sendTransportCommand(Command::Type::TransportPlay, fromTakts);
+}
+
+void transportStop() {
+    sendTransportCommand(Command::Type::TransportStop);
+}
+
+void transportSeek(double takts) {
+    sendTransportCommand(Command::Type::TransportSeek, takts);
+}
+
+void transportLoop(bool isLooping, double fromTakts, double toTakts) {
+    sendTransportCommand(Command::Type::TransportLoop, fromTakts, toTakts, isLooping);
+}
+
+// // returns the ParamId with that name, or -1
+int findParam(const std::string& name) {
+    for (int id = 0; id < nParams; ++id) {
+        if (name == paramInfos[id].name) return id;
+    }
+    return -1;
+}
+
+void setParam(int id, double value) {
+    synth.setParam(id, value);
+}
+
+double getParam(int id) {
+    return synth.getParam(id);
+}
+
+void setOscillator(OscillatorEngine engine, WavetableBank::Timbre timbre) {
+    synth.oscillatorEngine.store(engine, std::memory_order_relaxed);
+    synth.timbre.store(timbre, std::memory_order_relaxed);
+}
+
+void printStats(std::ostream& os) {
+    audioStats.print(os);
+}
+
+void resetStats() {
+    audioStats.requestReset();
+}
+
+bool isTransportPlaying() {
+    return synth.isTransportPlaying.load(std::memory_order_relaxed);
+}
+
+double getTransportPositionInTakts() {
+    return synth.transportPositionInTakts.load(std::memory_order_relaxed);
 }
 
 } // // namespace
@@ -0,0 +1,139 @@
+#ifndef SMALL_MONZO_H
+#define SMALL_MONZO_H
+
+#include <cstdint>
+
+#include "../external/discrete/primes.hpp"
+
+// // A ratio whose primes are all up to 31, as one 8-bit exponent per prime packed in 16 bytes. Products and quotients
+// // add and subtract the exponents lane by lane, in loops without dependencies between lanes that the compiler turns
+// // into a single vector instruction, and log2 is a dot product with the log2 of the primes.
+// // Ratios with a larger prime, and results whose exponents leave the 8 bits, are reported: callers then fall back to
+// // discrete::Monzo
+struct SmallMonzo {
+    static constexpr int nPrimes = 11;
+    static constexpr int nLanes = 16; // // the lanes after nPrimes are always 0
+    static constexpr int primes[nPrimes]{2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31};
+    static constexpr double log2Primes[nLanes]{
+        1.0, 1.5849625007211562, 2.321928094887362, 2.807354922057604, 3.4594316186372973, 3.700439718141092,
+        4.087462841250339, 4.247927513443585, 4.523561956057013, 4.857980995127572, 4.954196310386876,
+        0, 0, 0, 0, 0
+    };
+    
+    alignas(16) int8_t exponents[nLanes]{}; // // 1 by default
+    
+    // // return 1 if the ratio does not fit, leaving result unspecified
+    static int fromFraction(long long numerator, long long denominator, SmallMonzo& result) {
+        result = SmallMonzo{};
+        for (int sign = 1; sign >= -1; sign -= 2) {
+            long long x = sign > 0 ? numerator : denominator;
+            if (x <= 0) return 1;
+            for (int i = 0; i < nPrimes && x > 1; ++i) {
+                while (x % primes[i] == 0) {
+                    x /= primes[i];
+                    const int e = result.exponents[i] + sign;
+                    if (e < INT8_MIN || e > INT8_MAX) return 1;
+                    result.exponents[i] = (int8_t)e;
+                }
+            }
+            if (x != 1) return 1;
+        }
+        return 0;
+    }
+    static int fromMonzo(const discrete::Monzo& monzo, SmallMonzo& result) {
+        return fromFraction((long long)monzo.numerator(), (long long)monzo.denominator(), result);
+    }
+    
+    discrete::Monzo toMonzo() const {
+        static const discrete::Monzo primeMonzos[nPrimes]{
+            discrete::Monzo(2), discrete::Monzo(3), discrete::Monzo(5), discrete::Monzo(7), discrete::Monzo(11), discrete::Monzo(13),
+            discrete::Monzo(17), discrete::Monzo(19), discrete::Monzo(23), discrete::Monzo(29), discrete::Monzo(31)
+        };
+        discrete::Monzo result(1);
+        for (int i = 0; i < nPrimes; ++i) {
+            for (int k = 0; k < exponents[i]; ++k) result *= primeMonzos[i];
+            for (int k = 0; k > exponents[i]; --k) result /= primeMonzos[i];
+        }
+        return result;
+    }
+    
+    // // An 8-bit lane overflowed if its result has the sign of neither operand (sum) or not the sign of the first
+    // // operand when the operands differ in sign (difference). The checks of all lanes are ORed, so there is no branch per lane
+    static int multiply(const SmallMonzo& a, const SmallMonzo& b, SmallMonzo& result) {
+        uint8_t overflow = 0;
+        for (int i = 0; i < nLanes; ++i) {
+            const uint8_t x = (uint8_t)a.exponents[i], y = (uint8_t)b.exponents[i], r = (uint8_t)(x + y);
+            overflow |= (x ^ r) & (y ^ r);
+            result.exponents[i] = (int8_t)r;
+        }
+        return overflow >> 7;
+    }
+    static int divide(const SmallMonzo& a, const SmallMonzo& b, SmallMonzo& result) {
+        uint8_t overflow = 0;
+        for (int i = 0; i < nLanes; ++i) {
+            const uint8_t x = (uint8_t)a.exponents[i], y = (uint8_t)b.exponents[i], r = (uint8_t)(x - y);
+            overflow |= (x ^ y) & (x ^ r);
+            result.exponents[i] = (int8_t)r;
+        }
+        return overflow >> 7;
+    }
+    
+    double log2() const {
+        double result = 0;
+        for (int i = 0; i < nLanes; ++i) result += exponents[i] * log2Primes[i];
+        return result;
+    }
+    
+    // // numerator and denominator, if both are at most limit; return 1 otherwise, leaving them unspecified. Every partial
+    // // product is checked before it is taken, so nothing overflows
+    int toFraction(long long limit, long long& numerator, long long& denominator) const {
+        numerator = 1;
+        denominator = 1;
+        for (int i = 0; i < nPrimes; ++i) {
+            for (int k = 0; k < exponents[i]; ++k) {
+                if (numerator > limit / primes[i]) return 1;
+                numerator *= primes[i];
+            }
+            for (int k = 0; k > exponents[i]; --k) {
+                if (denominator > limit / primes[i]) return 1;
+                denominator *= primes[i];
+            }
+        }
+        return 0;
+    }
+    
+    // // like those of discrete::Monzo, they overflow for ratios too large for long long
+    long long numerator() const {
+        long long result = 1;
+        for (int i = 0; i < nPrimes; ++i) {
+            for (int k = 0; k < exponents[i]; ++k) result *= primes[i];
+        }
+        return result;
+    }
+    long long denominator() const {
+        long long result = 1;
+        for (int i = 0; i < nPrimes; ++i) {
+            for (int k = 0; k > exponents[i]; --k) result *= primes[i];
+        }
+        return result;
+    }
+    // // numerator and denominator are multiplied in double, which cannot overflow: 31^127 is far below its range.
+    // // While both stay below 2^53 they are exact, so the result is the correctly rounded ratio
+    explicit operator double() const {
+        double numerator = 1, denominator = 1;
+        for (int i = 0; i < nPrimes; ++i) {
+            for (int k = 0; k < exponents[i]; ++k) numerator *= primes[i];
+            for (int k = 0; k > exponents[i]; --k) denominator *= primes[i];
+        }
+        return numerator / denominator;
+    }
+    
+    friend bool operator==(const SmallMonzo& a, const SmallMonzo& b) {
+        for (int i = 0; i < nLanes; ++i) {
+            if (a.exponents[i] != b.exponents[i]) return false;
+        }
+        return true;
+    }
+};
+
+#endif /* end of include guard: SMALL_MONZO_H */
@@ -0,0 +1,104 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+#include "../external/SDL2/include/SDL.h"
+#include "../external/SDL_ttf/include/SDL_ttf.h"
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <functional>
+
+// // LRU cache of rendered labels keyed by (font, text, colour). A cached label costs one SDL_RenderCopy;
+// // a miss rasterizes it once with TTF_RenderText_Solid. The textures belong to the renderer given to get(),
+// // so clear() must be called before destroying that renderer
+struct TextCache {
+    struct Entry {
+        SDL_Texture* texture = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+    
+    TextCache(int _capacity = 256) : capacity{_capacity} {}
+    ~TextCache() { clear(); }
+    TextCache(const TextCache&) = delete;
+    TextCache& operator=(const TextCache&) = delete;
+    
+    // // returns nullptr if the text could not be rendered
+    const Entry* get(SDL_Renderer* renderer, TTF_Font* font, const std::string& text, SDL_Color color) {
+        Key key{font, text, packColor(color)};
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            ++hits;
+            order.splice(order.begin(), order, it->second.orderPosition);
+            return &it->second.entry;
+        }
+        ++misses;
+        
+        Entry entry;
+        SDL_Surface* surface = TTF_RenderText_Solid(font, text.c_str(), color);
+        if (!surface) return nullptr;
+        entry.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        entry.width = surface->w;
+        entry.height = surface->h;
+        SDL_FreeSurface(surface);
+        if (!entry.texture) return nullptr;
+        
+        if ((int)entries.size() >= capacity) evictLeastRecentlyUsed();
+        order.push_front(key);
+        Slot& slot = entries[key];
+        slot.entry = entry;
+        slot.orderPosition = order.begin();
+        return &slot.entry;
+    }
+    
+    void clear() {
+        for (auto& [key, slot] : entries) SDL_DestroyTexture(slot.entry.texture);
+        entries.clear();
+        order.clear();
+    }
+    
+    int getNumberOfEntries() const { return (int)entries.size(); }
+    long long getHits() const { return hits; }
+    long long getMisses() const { return misses; }
+    double getHitRate() const { return hits + misses > 0 ? (double)hits / (double)(hits + misses) : 0.0; }
+    void resetStatistics() { hits = misses = 0; }
+    
+private:
+    struct Key {
+        TTF_Font* font;
+        std::string text;
+        Uint32 color;
+        bool operator==(const Key& other) const { return font == other.font && color == other.color && text == other.text; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t h = std::hash<std::string>{}(key.text);
+            h ^= std::hash<const void*>{}(key.font) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<Uint32>{}(key.color) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+    struct Slot {
+        Entry entry;
+        std::list<Key>::iterator orderPosition;
+    };
+    
+    static Uint32 packColor(SDL_Color c) {
+        return ((Uint32)c.r << 24) | ((Uint32)c.g << 16) | ((Uint32)c.b << 8) | (Uint32)c.a;
+    }
+    void evictLeastRecentlyUsed() {
+        auto it = entries.find(order.back());
+        SDL_DestroyTexture(it->second.entry.texture);
+        entries.erase(it);
+        order.pop_back();
+    }
+    
+    int capacity;
+    std::list<Key> order; // // most recently used first
+    std::unordered_map<Key, Slot, KeyHash> entries;
+    long long hits = 0;
+    long long misses = 0;
+};
+
+#endif /* end of include guard: TEXT_CACHE_H */
@@ -0,0 +1,80 @@
+#ifndef WAV_WRITER_H
+#define WAV_WRITER_H
+
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+// // Writes 16-bit PCM WAV files through a large buffer. The sizes in the header are only known at the end,
+// // so close() goes back and patches them
+struct WavWriter {
+    ~WavWriter() { close(); }
+    
+    int open(const char* path, int _sampleRate, int _nChannels) {
+        close();
+        sampleRate = _sampleRate;
+        nChannels = _nChannels;
+        nDataBytes = 0;
+        fileBuffer.resize(1 << 20);
+        file.rdbuf()->pubsetbuf(fileBuffer.data(), fileBuffer.size());
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file) return 1;
+        writeHeader();
+        return file ? 0 : 1;
+    }
+    
+    // // samples are interleaved, in [-1, 1]
+    int write(const float* samples, int nSamples) {
+        bytes.resize(2 * nSamples);
+        for (int i = 0; i < nSamples; ++i) {
+            float x = std::max(-1.f, std::min(1.f, samples[i]));
+            uint16_t sample = (uint16_t)(int16_t)std::lround(x * 32767.f);
+            bytes[2*i] = (char)(sample & 0xff);
+            bytes[2*i+1] = (char)(sample >> 8);
+        }
+        file.write(bytes.data(), bytes.size());
+        nDataBytes += bytes.size();
+        return file ? 0 : 1;
+    }
+    
+    int close() {
+        if (!file.is_open()) return 0;
+        file.seekp(0);
+        writeHeader();
+        bool isOk = (bool)file;
+        file.close();
+        return isOk ? 0 : 1;
+    }
+    
+private:
+    void putLittleEndian(uint32_t x, int nBytes) {
+        for (int i = 0; i < nBytes; ++i) file.put((char)((x >> (8*i)) & 0xff));
+    }
+    void writeHeader() {
+        const int bytesPerFrame = 2 * nChannels;
+        file.write("RIFF", 4);
+        putLittleEndian((uint32_t)(36 + nDataBytes), 4);
+        file.write("WAVE", 4);
+        file.write("fmt ", 4);
+        putLittleEndian(16, 4); // // size of the fmt chunk
+        putLittleEndian(1, 2); // // PCM
+        putLittleEndian(nChannels, 2);
+        putLittleEndian(sampleRate, 4);
+        putLittleEndian(sampleRate * bytesPerFrame, 4);
+        putLittleEndian(bytesPerFrame, 2);
+        putLittleEndian(16, 2); // // bits per sample
+        file.write("data", 4);
+        putLittleEndian((uint32_t)nDataBytes, 4);
+    }
+    
+    std::ofstream file;
+    std::vector<char> fileBuffer;
+    std::vector<char> bytes; // // little-endian samples
+    long long nDataBytes = 0;
+    int sampleRate = 0;
+    int nChannels = 0;
+};
+
+#endif /* end of include guard: WAV_WRITER_H */
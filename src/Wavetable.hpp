@@ -0,0 +1,142 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <string_view>
+#include <cstdint>
+
+// // Band-limited single-cycle waveforms, one table per octave ("mip-maps"), built once per sample rate by
+// // additive synthesis. The table of an octave only holds the harmonics that stay below Nyquist at the top of
+// // that octave, so no note aliases; higher octaves get fewer harmonics
+struct WavetableBank {
+    enum class Timbre {
+        Saw,
+        Square,
+        Triangle,
+        Sine,
+        SoftSaw, // // a saw through a one-pole low-pass at 6 times its frequency, like the saw+LP oscillator
+        nTimbres
+    };
+    static constexpr int nTimbres = (int)Timbre::nTimbres;
+    static constexpr const char* timbreNames[nTimbres]{"saw", "square", "triangle", "sine", "soft_saw"};
+    
+    static constexpr int tableBits = 11;
+    static constexpr int tableSize = 1 << tableBits; // // each table has one more sample, a copy of the first, for interpolation
+    static constexpr int nOctaves = 11;
+    static constexpr double lowestFrequency = 20.; // // octave k starts at lowestFrequency * 2^k
+    
+    std::vector<float> samples; // // tables of tableSize+1 samples, by timbre and then by octave
+    int sampleRate = 0;
+    
+    // // returns -1 if there is no timbre with that name
+    static int findTimbre(const char* name) {
+        for (int t = 0; t < nTimbres; ++t) {
+            if (std::string_view(name) == timbreNames[t]) return t;
+        }
+        return -1;
+    }
+    
+    static double getHarmonicAmplitude(Timbre timbre, int k) {
+        const double pi = 3.14159265358979323846;
+        switch (timbre) {
+            case Timbre::Saw:
+                return -2./(pi*k);
+            case Timbre::Square:
+                return k % 2 ? 4./(pi*k) : 0.;
+            case Timbre::Triangle:
+                return k % 2 ? ((k/2) % 2 ? -1. : 1.) * 8./(pi*pi*k*k) : 0.;
+            case Timbre::Sine:
+                return k == 1 ? 1. : 0.;
+            case Timbre::SoftSaw:
+                return -2./(pi*k) / std::sqrt(1. + (k/6.)*(k/6.));
+            default:
+                return 0.;
+        }
+    }
+    
+    // // takes a few milliseconds; sines are read from a table, since every k*n lands on one of its points
+    void build(int _sampleRate) {
+        if (sampleRate == _sampleRate) return;
+        sampleRate = _sampleRate;
+        samples.assign((size_t)nTimbres * nOctaves * (tableSize+1), 0.f);
+        std::vector<double> sine(tableSize);
+        for (int n = 0; n < tableSize; ++n) sine[n] = std::sin(2. * 3.14159265358979323846 * n / tableSize);
+        std::vector<double> cycle(tableSize);
+        for (int t = 0; t < nTimbres; ++t) {
+            double gain = 0; // // normalizes the richest table of the timbre to a peak of 1, and the others alike
+            for (int octave = 0; octave < nOctaves; ++octave) {
+                const double topFrequency = lowestFrequency * std::exp2(octave + 1);
+                const int nHarmonics = std::clamp((int)(0.5 * sampleRate / topFrequency), 1, tableSize/2 - 1);
+                std::fill(cycle.begin(), cycle.end(), 0.);
+                for (int k = 1; k <= nHarmonics; ++k) {
+                    const double a = getHarmonicAmplitude((Timbre)t, k);
+                    if (a == 0) continue;
+                    for (int n = 0; n < tableSize; ++n) cycle[n] += a * sine[(size_t)k * n % tableSize];
+                }
+                if (octave == 0) {
+                    double peak = 0;
+                    for (double x : cycle) peak = std::max(peak, std::abs(x));
+                    gain = peak > 0 ? 1. / peak : 1.;
+                }
+                float* table = &samples[((size_t)t * nOctaves + octave) * (tableSize+1)];
+                for (int n = 0; n < tableSize; ++n) table[n] = (float)(gain * cycle[n]);
+                table[tableSize] = table[0];
+            }
+        }
+    }
+    
+    const float* getTable(Timbre timbre, double frequency) const {
+        const int octave = std::clamp((int)std::floor(std::log2(frequency / lowestFrequency)), 0, nOctaves-1);
+        return &samples[((size_t)timbre * nOctaves + octave) * (tableSize+1)];
+    }
+};
+
+// // Reads one table of the bank with linear interpolation. Same interface as ScoreSynth::Oscillator.
+// // The phase is a 32-bit fixed-point fraction of the cycle: it wraps by itself, and its top bits index the table
+struct WavetableOscillator {
+    static constexpr int fractionBits = 32 - WavetableBank::tableBits;
+    static constexpr uint32_t fractionMask = (1u << fractionBits) - 1;
+    
+    const float* table = nullptr;
+    uint32_t phase = 0;
+    uint32_t dphase = 0;
+    double y[2]{0, 0};
+    
+    void freq(const WavetableBank& bank, WavetableBank::Timbre timbre, double f, double dt) {
+        table = bank.getTable(timbre, f);
+        dphase = (uint32_t)std::llround(std::min(f * dt, 0.5) * 4294967296.);
+    }
+    
+    static float read(const float* table, uint32_t phase) {
+        const uint32_t i = phase >> fractionBits;
+        const float frac = (float)(phase & fractionMask) * (1.f / (1u << fractionBits));
+        return table[i] + frac * (table[i+1] - table[i]);
+    }
+    
+    void operator()() {
+        phase += dphase;
+        y[0] = y[1] = read(table, phase);
+    }
+    
+    // // adds amp times the next n samples to both channels. The phases of a chunk come first, from a loop
+    // // without dependencies between samples that the compiler vectorizes; then the table is read
+    void render(double amp, double* left, double* right, int n) {
+        constexpr int chunkSize = 64;
+        uint32_t phases[chunkSize];
+        for (int i0 = 0; i0 < n; i0 += chunkSize) {
+            const int m = std::min(chunkSize, n - i0);
+            for (int i = 0; i < m; ++i) phases[i] = phase + (uint32_t)(i+1) * dphase;
+            phase += (uint32_t)m * dphase;
+            for (int i = 0; i < m; ++i) {
+                const double x = amp * read(table, phases[i]);
+                left[i0+i] += x;
+                right[i0+i] += x;
+            }
+        }
+        y[0] = y[1] = read(table, phase);
+    }
+};
+
+#endif /* end of include guard: WAVETABLE_H */
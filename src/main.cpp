@@ -1,6 +1,7 @@
 #include "ScoreFile.hpp"
 #include "ScoreEditor.hpp"
 #include "ScorePlayer.hpp"
+#include "WavWriter.hpp"
 
 #include <iostream>
 #include <iomanip>
@@ -9,64 +10,344 @@
 #include <thread>
 #include <atomic>
 #include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
 
 ScoreFile scoreFile;
 ScoreEditor scoreEditor{scoreFile};
 std::string filePath;
 
 std::vector<std::pair<std::string,float*>> allParams{
-    //{"rev_decay", &ScorePlayer::ScoreSynth::rev.decay},
     { "rootPositionInPixels0", &scoreEditor.rootPositionInPixels[0] },
     //{ "rootPositionInPixels1", &scoreEditor.rootPositionInPixels[1] },
     { "taktSizeInPixels", &scoreEditor.taktSizeInPixels }
 };
 
-enum class CommunicationState {
-    Idle,
-    DataToBeWritten,
-    PreparedToWrite,
-    Writing
-};
+// // UI COMMANDS
+// // Other threads never touch the editor or the score: they post closures that the main loop runs between frames.
+std::mutex uiCommandsMutex;
+std::vector<std::function<void()>> uiCommands; // // guarded by uiCommandsMutex
+std::vector<std::function<void()>> uiCommandsRunning; // // only touched by the main loop
+
+void postToUi(std::function<void()> command) {
+    {
+        std::lock_guard<std::mutex> lock(uiCommandsMutex);
+        uiCommands.push_back(std::move(command));
+    }
+    ScoreEditor::wake();
+}
+
+// // called by the main loop at frame boundaries
+void runUiCommands() {
+    {
+        std::lock_guard<std::mutex> lock(uiCommandsMutex);
+        if (uiCommands.empty()) return;
+        uiCommands.swap(uiCommandsRunning);
+    }
+    for (auto& command : uiCommandsRunning) command();
+    uiCommandsRunning.clear();
+    scoreEditor.needsRedraw = true;
+}
 
-std::atomic<CommunicationState> communicationState; // // 0:none, 1:dataToBeWritten, 2:preparedToWrite, 3:writing
 bool isWaitingInput = false;
 bool doConsoleWork = true;
 
-int changeAudioParam(std::stringstream& ss, std::string word, double& synthParam, double minValue, double maxValue) {
-    std::string paramName = word;
+// // synth parameters are lock-free, so the console thread sets them directly while the sound goes on
+int changeAudioParam(std::stringstream& ss, int paramId) {
+    const ScorePlayer::ParamInfo& info = ScorePlayer::paramInfos[paramId];
+    std::string word;
     std::getline(ss, word, ' ');
     if (word == "get") {
-        std::cout << ">> " << synthParam << '\n';
+        std::cout << ">> " << ScorePlayer::getParam(paramId) << '\n';
     }
     else {
-        double param;
+        double value;
         try {
-            param = std::stod(word);
+            value = std::stod(word);
         }
         catch(...) {
             return 1;
         }
-        if (param < 0) param = 0;
-        if (param > 1) param = 1;
-        communicationState = CommunicationState::DataToBeWritten;
-        while (communicationState != CommunicationState::PreparedToWrite) {}
-        communicationState = CommunicationState::Writing;
-        ScorePlayer::stop(true);
-        while (ScorePlayer::ScoreSynth::state[0] != ScorePlayer::ScoreSynth::State::Idle) {}
-        synthParam = param;
-        communicationState = CommunicationState::Idle;
-        std::cout << ">> " << paramName << " = " << param << '\n';
+        value = std::clamp(value, info.minValue, info.maxValue);
+        ScorePlayer::setParam(paramId, value);
+        std::cout << ">> " << info.name << " = " << value << '\n';
+    }
+    return 0;
+}
+
+// // copies the settings of the session into the params of the score
+void storeParams() {
+    for (const auto& [name, pValue] : allParams) {
+        scoreFile.changeParam(name, *pValue);
+    }
+    for (int id = 0; id < ScorePlayer::nParams; ++id) {
+        scoreFile.changeParam(ScorePlayer::paramInfos[id].name, ScorePlayer::getParam(id));
+    }
+    scoreFile.changeParam("oscillator", (double)ScorePlayer::synth.oscillatorEngine.load());
+    scoreFile.changeParam("timbre", (double)ScorePlayer::synth.timbre.load());
+}
+
+// // the synth params stored in the score; missing ones keep their defaults
+void loadSynthParams(const ScoreFile& score, ScorePlayer::ScoreSynth& synth) {
+    const auto& params = score.getParams();
+    for (int id = 0; id < ScorePlayer::nParams; ++id) {
+        auto it = params.find(ScorePlayer::paramInfos[id].name);
+        if (it != params.end()) synth.initParam(id, it->second);
+    }
+    auto engineIt = params.find("oscillator");
+    if (engineIt != params.end() && 0 <= engineIt->second && engineIt->second < (int)ScorePlayer::OscillatorEngine::nEngines) {
+        synth.oscillatorEngine = (ScorePlayer::OscillatorEngine)(int)engineIt->second;
+    }
+    auto timbreIt = params.find("timbre");
+    if (timbreIt != params.end() && 0 <= timbreIt->second && timbreIt->second < WavetableBank::nTimbres) {
+        synth.timbre = (WavetableBank::Timbre)(int)timbreIt->second;
+    }
+}
+
+// // oscillator saw_lp | oscillator wavetable [timbre] | oscillator get. Applies to the notes started afterwards
+int oscillatorCommand(std::stringstream& ss) {
+    std::string word;
+    std::getline(ss, word, ' ');
+    if (word == "get") {
+        const auto engine = ScorePlayer::synth.oscillatorEngine.load();
+        std::cout << ">> " << ScorePlayer::oscillatorEngineNames[(int)engine];
+        if (engine == ScorePlayer::OscillatorEngine::Wavetable) std::cout << ' ' << WavetableBank::timbreNames[(int)ScorePlayer::synth.timbre.load()];
+        std::cout << '\n';
+        return 0;
+    }
+    int engine = -1;
+    for (int e = 0; e < (int)ScorePlayer::OscillatorEngine::nEngines; ++e) {
+        if (word == ScorePlayer::oscillatorEngineNames[e]) engine = e;
+    }
+    if (engine < 0) return 1;
+    int timbre = (int)ScorePlayer::synth.timbre.load();
+    if (std::getline(ss, word, ' ')) {
+        timbre = WavetableBank::findTimbre(word.c_str());
+        if (timbre < 0) return 1;
+    }
+    ScorePlayer::setOscillator((ScorePlayer::OscillatorEngine)engine, (WavetableBank::Timbre)timbre);
+    std::cout << ">> oscillator changed\n";
+    return 0;
+}
+
+// // TRANSPORT
+// // The score is compiled into a timeline for ScorePlayer whenever it is played after a change
+unsigned long long timelineRevision = 0;
+bool hasTimeline = false;
+
+std::unique_ptr<ScorePlayer::Timeline> compileTimeline(const ScoreFile& score, int sampleRate) {
+    auto timeline = std::make_unique<ScorePlayer::Timeline>(score.getTaktDurationInSeconds() * sampleRate);
+    const int rootId = score.getRootId();
+    for (int id = 0; id < score.getNumberOfSlots(); ++id) {
+        if (!score.isNode(id)) continue;
+        timeline->addNote(score.getRelativePositionInTakts(rootId, id), score.getDurationInTakts(id), score.getFrequency(id));
+    }
+    timeline->finish();
+    return timeline;
+}
+
+// // must run on the main thread, after ScorePlayer::init has settled the sample rate
+const ScorePlayer::Timeline& updateTimeline() {
+    if (hasTimeline && timelineRevision == scoreFile.getRevision()) return *ScorePlayer::getLatestTimeline();
+    ScorePlayer::setTimeline(compileTimeline(scoreFile, ScorePlayer::audioSettings.sampleRate));
+    timelineRevision = scoreFile.getRevision();
+    hasTimeline = true;
+    return *ScorePlayer::getLatestTimeline();
+}
+
+// // plays from the given takt, or from the beginning of the score if it comes earlier
+void playScore(double fromTakts) {
+    const ScorePlayer::Timeline& timeline = updateTimeline();
+    ScorePlayer::transportPlay(std::max(fromTakts, timeline.frameToTakts(timeline.getStartFrame())));
+}
+
+int transportCommand(std::stringstream& ss) {
+    std::string word;
+    std::getline(ss, word, ' ');
+    if (word == "play") {
+        double fromTakts = -1e300;
+        if (std::getline(ss, word, ' ')) fromTakts = std::stod(word);
+        postToUi([fromTakts]() { playScore(fromTakts); });
+    }
+    else if (word == "stop") {
+        ScorePlayer::transportStop();
+    }
+    else if (word == "seek") {
+        std::getline(ss, word, ' ');
+        ScorePlayer::transportSeek(std::stod(word));
+    }
+    else if (word == "loop") {
+        std::getline(ss, word, ' ');
+        if (word == "off") {
+            ScorePlayer::transportLoop(false, 0, 0);
+            return 0;
+        }
+        double fromTakts = std::stod(word);
+        std::getline(ss, word, ' ');
+        double toTakts = std::stod(word);
+        if (toTakts <= fromTakts) return 1;
+        ScorePlayer::transportLoop(true, fromTakts, toTakts);
+    }
+    else {
+        return 1;
+    }
+    return 0;
+}
+
+// // OFFLINE RENDER
+// // Scores are rendered without SDL or an audio device: each file gets its own ScoreSynth, driven as fast as
+// // the CPU allows, and the files are spread over the cores
+struct RenderJob {
+    std::string pathIn;
+    std::string pathOut;
+    double audioSeconds = 0;
+    double wallSeconds = 0;
+};
+std::mutex renderOutputMutex;
+
+int renderScore(RenderJob& job) {
+    auto t0 = std::chrono::steady_clock::now();
+    ScoreFile score;
+    if (0 != score.readFromDisk(job.pathIn.c_str())) {
+        std::lock_guard<std::mutex> lock(renderOutputMutex);
+        std::cerr << ">> ERROR: could not open file " << job.pathIn << '\n';
+        return 1;
+    }
+    const int sampleRate = ScorePlayer::audioSettings.sampleRate;
+    const int nChannels = ScorePlayer::audioSettings.nChannels;
+    auto timeline = compileTimeline(score, sampleRate);
+    auto synth = std::make_unique<ScorePlayer::ScoreSynth>();
+    synth->Start(ScorePlayer::audioSettings.maxVoices, sampleRate);
+    loadSynthParams(score, *synth);
+    
+    ScorePlayer::Command command{};
+    command.type = ScorePlayer::Command::Type::SetTimeline;
+    command.timeline = timeline.get();
+    synth->process(command);
+    command.type = ScorePlayer::Command::Type::TransportPlay;
+    command.takts[0] = timeline->frameToTakts(timeline->getStartFrame());
+    synth->process(command);
+    
+    WavWriter wav;
+    if (0 != wav.open(job.pathOut.c_str(), sampleRate, nChannels)) {
+        std::lock_guard<std::mutex> lock(renderOutputMutex);
+        std::cerr << ">> ERROR: could not create file " << job.pathOut << '\n';
+        return 1;
+    }
+    
+    // // after the last note, the reverb tail is rendered until it stays below -90 dB for half a second (10 s at most)
+    const int blockSize = 4096;
+    const long long maxTailFrames = 10LL * sampleRate;
+    const long long silentTailFrames = sampleRate / 2;
+    std::vector<float> block(nChannels*blockSize);
+    long long nFrames = 0, tailFrames = 0, silentFrames = 0;
+    bool isWritten = true;
+    while (tailFrames < maxTailFrames && silentFrames < silentTailFrames) {
+        synth->Render(block.data(), blockSize, nChannels);
+        if (0 != wav.write(block.data(), (int)block.size())) {
+            isWritten = false;
+            break;
+        }
+        nFrames += blockSize;
+        if (synth->isTransportRunning || synth->state != ScorePlayer::ScoreSynth::State::Idle) continue;
+        tailFrames += blockSize;
+        float peak = 0;
+        for (float x : block) peak = std::max(peak, std::abs(x));
+        silentFrames = peak < 3e-5f ? silentFrames + blockSize : 0;
+    }
+    if (0 != wav.close() || !isWritten) {
+        std::lock_guard<std::mutex> lock(renderOutputMutex);
+        std::cerr << ">> ERROR: could not write file " << job.pathOut << '\n';
+        return 1;
     }
+    
+    job.audioSeconds = (double)nFrames / sampleRate;
+    job.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> lock(renderOutputMutex);
+    std::cout << ">> rendered " << job.pathIn << " into " << job.pathOut << ": " << job.audioSeconds << " s of audio in "
+        << job.wallSeconds << " s, real-time factor " << job.audioSeconds / job.wallSeconds << '\n';
     return 0;
 }
 
+int renderFiles(std::vector<RenderJob>& jobs) {
+    auto t0 = std::chrono::steady_clock::now();
+    const int nThreads = std::max(1, std::min((int)jobs.size(), (int)std::thread::hardware_concurrency()));
+    std::atomic<int> nextJob{0};
+    std::atomic<int> nFailed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nThreads; ++t) {
+        threads.emplace_back([&]() {
+            for (int j = nextJob++; j < jobs.size(); j = nextJob++) {
+                if (0 != renderScore(jobs[j])) ++nFailed;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    
+    double audioSeconds = 0;
+    for (const auto& job : jobs) audioSeconds += job.audioSeconds;
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << ">> rendered " << jobs.size() - nFailed << " of " << jobs.size() << " files on " << nThreads << " threads: "
+        << audioSeconds << " s of audio in " << wallSeconds << " s, real-time factor " << audioSeconds / wallSeconds << '\n';
+    return nFailed == 0 ? 0 : 1;
+}
+
+// // AUTOSAVE
+// // The main loop hands a snapshot of the score (only what is written to disk) to autosaveWorker, which writes it without blocking the UI thread.
+const double autosaveIntervalInSeconds = 30.;
+std::mutex autosaveMutex;
+std::condition_variable autosaveCondition;
+ScoreFile::Snapshot autosaveSnapshot; // // only touched by autosaveWorker while isAutosavePending
+bool isAutosavePending = false;
+bool doAutosaveWork = true;
+unsigned long long savedRevision = 0;
+std::chrono::steady_clock::time_point lastAutosaveTime;
+
+void autosaveWorker() {
+    std::unique_lock<std::mutex> lock(autosaveMutex);
+    while (true) {
+        autosaveCondition.wait(lock, []{ return isAutosavePending || !doAutosaveWork; });
+        if (!isAutosavePending) break;
+        lock.unlock();
+        int result = autosaveSnapshot.writeToDisk(filePath.c_str());
+        lock.lock();
+        isAutosavePending = false;
+        if (result != 0) {
+            std::cerr << ">> ERROR: could not autosave file " << filePath << ".\n";
+        }
+    }
+}
+
+// // called by the main loop at frame boundaries
+void autosaveIfNeeded() {
+    if (scoreFile.getRevision() == savedRevision) return;
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastAutosaveTime).count() < autosaveIntervalInSeconds) return;
+    std::unique_lock<std::mutex> lock(autosaveMutex, std::try_to_lock);
+    if (!lock.owns_lock() || isAutosavePending) return; // // the previous autosave is still being written, try again next frame
+    storeParams();
+    autosaveSnapshot = scoreFile.getSnapshot();
+    isAutosavePending = true;
+    savedRevision = scoreFile.getRevision();
+    lastAutosaveTime = now;
+    autosaveCondition.notify_one();
+}
+
 std::string argumentExplanation = "The first argument must be either the word \"open\" or the word \"new\" (without quotes). The argument following the word \"open\" must be the path to an existing file in the computer. The word \"new\" must be followed by a feasible path where a new file can be created.";
+std::string renderExplanation = "To render scores to audio without opening the editor, provide the word \"render\" followed by pairs of paths: an existing score and the .wav file to write. The files are rendered in parallel.";
+std::string audioOptionsExplanation = "Before any of these, the audio can be configured with --sample-rate=n (in Hz), --period-ms=x (the size of the device period in milliseconds, decimals allowed), --periods=n and --channels=n. A value of 0 lets the audio device choose. Renders use the sample rate (44100 Hz if 0) and the number of channels (2 if 0). --voices=n (64 by default) sets how many notes sound at once, live and in renders; past that, new notes take the voice of the oldest one.";
+std::string convertExplanation = "To translate a score between json and the binary format, provide 3 arguments: the word \"convert\", the path of an existing score and the path of the new file. Paths ending with " + ScoreFile::binaryExtension + " are written in the binary format, any other path is written as json.";
 
 void printHelp() {
     for (int i = 0; i < 60; ++i) std::cout << "-"; std::cout << '\n';
     std::cout << "This program allows you to create and listen to small snippets in just intonation. It's like a MIDI roll, but instead of using absolute pitches, each note is defined using another note (its parent) and a rational number (the ratio from its parent). What the program does is reading and writing files with json syntax. It reads or creates a file, and when terminated writes all the changes.\n";
     std::cout << '\n';
     std::cout << "The program must be executed from a console and 2 arguments must be provided. " << argumentExplanation << '\n';
+    std::cout << convertExplanation << '\n';
+    std::cout << renderExplanation << '\n';
+    std::cout << audioOptionsExplanation << '\n';
     std::cout << '\n';
     std::cout << "This is how you interact with the editor:\n";
     std::cout << "    * Use left and right arrow keys to move around.\n";
@@ -76,10 +357,19 @@ void printHelp() {
         std::cout << "    "<<"    " << info.code << ": " << info.name << '\n';
     }
     std::cout << "    * Left-clicks. The action depends on the edit mode.\n";
+    std::cout << "    * Press the space bar to play the score from the left edge of the window, and again to stop it.\n";
     std::cout << '\n';
     std::cout << "You can write several commands in the console to make further changes:\n";
     std::cout << "    * limit n (where n is an integer and 15<n<100): n will be the greatest numerator or denominator (ignoring factors that are powers of 2) of the ratios that can be selected.\n";
-    std::cout << "    * rev_decay x (where x is a decimal number, 0.0 <= x <= 1.0): the decay time of the reverberation. Smaller values mean dryer sound.\n";
+    for (const auto& info : ScorePlayer::paramInfos) {
+        std::cout << "    * " << info.name << " x (where x is a decimal number, " << info.minValue << " <= x <= " << info.maxValue << "): " << info.description << ". Write \"" << info.name << " get\" to see the current value.\n";
+    }
+    std::cout << "    * transport play [t], transport stop, transport seek t: play the score from takt t (or from its beginning), stop it, or jump to takt t.\n";
+    std::cout << "    * transport loop a b, transport loop off: repeat the takts from a to b while playing, or stop repeating.\n";
+    std::cout << "    * oscillator saw_lp, oscillator wavetable [timbre], oscillator get: play the next notes with a low-passed saw (which follows lp_multiplier) or with band-limited wavetables, lighter on the CPU. The timbres are";
+    for (const char* name : WavetableBank::timbreNames) std::cout << ' ' << name;
+    std::cout << ".\n";
+    std::cout << "    * stats, stats reset: show the timing of the audio callback (DSP load, render times, underruns, voices), or start measuring anew.\n";
     std::cout << '\n';
     std::cout << "It sometimes comes in handy to convert a ratio to semitones. Type\n";
     std::cout << "    * get_st m/n (where m and n are integers).\n";
@@ -108,13 +398,12 @@ void consoleWorker() {
                     std::cout << ">> ERROR: value must be between 16 and 100\n";
                 }
                 else {
-                    auto menuCollections_tmp = ScoreEditor::calculatePossibleRatios(N);
-                    communicationState = CommunicationState::DataToBeWritten;
-                    while (communicationState != CommunicationState::PreparedToWrite) {}
-                    communicationState = CommunicationState::Writing;
-                    scoreEditor.menuCollections = menuCollections_tmp;
-                    communicationState = CommunicationState::Idle;
-                    std::cout << ">> limit has been changed\n";
+                    // // found or computed here, so that the UI only swaps a pointer
+                    std::shared_ptr<RatioMenus> ratioMenus = RatioMenus::get(N);
+                    postToUi([ratioMenus]() {
+                        scoreEditor.ratioMenus = ratioMenus;
+                        std::cout << ">> limit has been changed\n";
+                    });
                 }
             }
             else if (word == "play") {
@@ -124,11 +413,30 @@ void consoleWorker() {
             else if (word == "stop") {
                 ScorePlayer::stop();
             }
-            else if (word == "rev_decay") {
-                if (changeAudioParam(ss, word, ScorePlayer::ScoreSynth::rev.decay, 0., 1.)) {
+            else if (int paramId = ScorePlayer::findParam(word); paramId >= 0) {
+                if (changeAudioParam(ss, paramId)) {
+                    throw "err";
+                }
+            }
+            else if (word == "transport") {
+                if (transportCommand(ss)) {
+                    throw "err";
+                }
+            }
+            else if (word == "oscillator") {
+                if (oscillatorCommand(ss)) {
                     throw "err";
                 }
             }
+            else if (word == "stats") {
+                if (std::getline(ss, word, ' ') && word == "reset") {
+                    ScorePlayer::resetStats();
+                    std::cout << ">> audio stats will be reset\n";
+                }
+                else {
+                    ScorePlayer::printStats(std::cout);
+                }
+            }
             else if (word == "help") {
                 printHelp();
             }
@@ -167,7 +475,70 @@ inline bool fileExists (const std::string& name) {
   return (stat (name.c_str(), &buffer) == 0);
 }
 
+int convertFile(const std::string& pathIn, const std::string& pathOut) {
+    if (fileExists(pathOut)) {
+        std::cerr << ">> ERROR: could not convert, " << pathOut << " already exists" << '\n';
+        return 1;
+    }
+    if (0 != scoreFile.readFromDisk(pathIn.c_str())) {
+        std::cerr << ">> ERROR: could not open file " << pathIn << '\n';
+        return 1;
+    }
+    if (0 != scoreFile.writeToDisk(pathOut.c_str())) {
+        std::cerr << ">> ERROR: could not create file " << pathOut << '\n';
+        return 1;
+    }
+    std::cout << ">> converted " << pathIn << " into " << pathOut << '\n';
+    return 0;
+}
+
+// // removes the leading --option=value arguments from args and applies them to ScorePlayer::audioSettings
+int parseAudioOptions(int& argv, char**& args) {
+    int nOptions = 0;
+    while (1 + nOptions < argv && std::string(args[1 + nOptions]).rfind("--", 0) == 0) {
+        const std::string option = args[1 + nOptions];
+        const size_t equalsPos = option.find('=');
+        if (equalsPos == std::string::npos) return 1;
+        const std::string name = option.substr(2, equalsPos - 2);
+        const std::string value = option.substr(equalsPos + 1);
+        try {
+            if (name == "sample-rate") ScorePlayer::audioSettings.sampleRate = std::stoi(value);
+            else if (name == "period-ms") ScorePlayer::audioSettings.periodSizeInMilliseconds = std::stod(value);
+            else if (name == "periods") ScorePlayer::audioSettings.nPeriods = std::stoi(value);
+            else if (name == "channels") ScorePlayer::audioSettings.nChannels = std::stoi(value);
+            else if (name == "voices") ScorePlayer::audioSettings.maxVoices = std::stoi(value);
+            else return 1;
+        }
+        catch(...) {
+            return 1;
+        }
+        ++nOptions;
+    }
+    const auto& settings = ScorePlayer::audioSettings;
+    if (settings.sampleRate < 0 || settings.periodSizeInMilliseconds < 0 || settings.nPeriods < 0 || settings.nChannels < 0 || settings.maxVoices < 1) return 1;
+    // // the program name stays in front
+    args[nOptions] = args[0];
+    args += nOptions;
+    argv -= nOptions;
+    return 0;
+}
+
 int main(int argv, char** args) {
+    if (0 != parseAudioOptions(argv, args)) {
+        std::cerr << ">> ERROR: wrong audio option. " << audioOptionsExplanation << '\n';
+        return 1;
+    }
+    if (argv == 4 && std::string(args[1]) == "convert") {
+        return convertFile(args[2], args[3]);
+    }
+    if (argv >= 4 && argv % 2 == 0 && std::string(args[1]) == "render") {
+        auto& settings = ScorePlayer::audioSettings;
+        if (settings.sampleRate == 0) settings.sampleRate = ScorePlayer::ScoreSynth::defaultSampleRate;
+        if (settings.nChannels == 0) settings.nChannels = 2;
+        std::vector<RenderJob> jobs;
+        for (int i = 2; i < argv; i += 2) jobs.push_back({args[i], args[i+1]});
+        return renderFiles(jobs);
+    }
     std::string errorString = ">> ERROR: 2 arguments must be provided. " + argumentExplanation;
     if (argv != 3) {
         std::cerr << errorString << '\n';
@@ -196,17 +567,13 @@ int main(int argv, char** args) {
             return 1;
         }
         
-        std::ifstream f(filePath);
-        nlohmann::json data = nlohmann::json::parse(f);
-        auto it = data["params"].find("rev_decay");
-        if (it != data["params"].end()) {
-            ScorePlayer::ScoreSynth::rev.decay = *it;
-        }
+        const auto& params = scoreFile.getParams();
+        loadSynthParams(scoreFile, ScorePlayer::synth);
         
         for (auto& [name, pValue] : allParams) {
-            auto it = data["params"].find(name);
-            if (it != data["params"].end()) {
-                *pValue = *it;
+            auto it = params.find(name);
+            if (it != params.end()) {
+                *pValue = it->second;
             }
         }
     }
@@ -216,6 +583,9 @@ int main(int argv, char** args) {
     }
 
     std::thread consoleThread(consoleWorker);
+    savedRevision = scoreFile.getRevision();
+    lastAutosaveTime = std::chrono::steady_clock::now();
+    std::thread autosaveThread(autosaveWorker);
     
     scoreEditor.init(filePath);
     
@@ -224,13 +594,28 @@ int main(int argv, char** args) {
     std::vector<double> freqs;
     freqs.reserve(20); // // arbitrary size?
     while (1) {
-        if (communicationState == CommunicationState::DataToBeWritten) {
-            communicationState = CommunicationState::PreparedToWrite;
-            while (communicationState != CommunicationState::Idle) {}
+        runUiCommands();
+        // // the playback cursor moves on its own, and once more to disappear when the transport stops
+        const bool isPlayingScore = ScorePlayer::isTransportPlaying();
+        if (isPlayingScore || scoreEditor.isPlaybackCursorVisible) {
+            scoreEditor.isPlaybackCursorVisible = isPlayingScore;
+            scoreEditor.playbackCursorTakts = ScorePlayer::getTransportPositionInTakts();
+            scoreEditor.needsRedraw = true;
         }
+        
         int updateResult = scoreEditor.update();
-        if (updateResult == ScoreEditor::updateCode_skip) continue;
         if (updateResult == ScoreEditor::updateCode_abort) break;
+        autosaveIfNeeded();
+        if (updateResult == ScoreEditor::updateCode_skip) continue;
+        
+        if (scoreEditor.isPlaybackToggleRequested) {
+            if (isPlayingScore) ScorePlayer::transportStop();
+            else playScore(std::floor(-scoreEditor.rootPositionInPixels[0] / scoreEditor.taktSizeInPixels));
+        }
+        else if (isPlayingScore && scoreFile.getRevision() != timelineRevision) {
+            updateTimeline(); // // edits are heard while playing
+        }
+        
         scoreEditor.draw();
         
         // // audio
@@ -269,12 +654,8 @@ int main(int argv, char** args) {
             int takts = (int)std::roundf(scoreEditor.mouseX_taktsFromRoot-0.5f);
             int takts_prev = (int)std::roundf(scoreEditor.mouseX_taktsFromRoot_prev-0.5f);
             if (scoreEditor.isMouseClick || (scoreEditor.isMouseHeldDown && takts != takts_prev)) {
-                freqs.clear();
-                for (int i = 0; i < scoreEditor.nodes.size(); ++i) {
-                    int t = scoreEditor.nodes[i].taktsFromRoot;
-                    if (takts < t || t+scoreFile.getDurationInTakts(i) <= takts) continue;
-                    freqs.push_back(scoreFile.getFrequency(i));
-                }
+                const ScorePlayer::Timeline& timeline = updateTimeline();
+                timeline.getFrequenciesAt(timeline.taktsToFrame(takts), freqs);
                 if (freqs.empty()) {
                     ScorePlayer::stop();
                 }
@@ -287,27 +668,23 @@ int main(int argv, char** args) {
     
     ScorePlayer::stop(true);
     
+    {
+        std::lock_guard<std::mutex> lock(autosaveMutex);
+        doAutosaveWork = false;
+    }
+    autosaveCondition.notify_one();
+    autosaveThread.join(); // // lets a pending autosave finish before the final save
+    
+    storeParams();
     if (0 != scoreFile.writeToDisk(filePath.c_str())) {
         std::cerr << ">> ERROR: could not save file " << filePath << ".\n";
     }
     else {
-        std::ifstream fIn(filePath);
-        nlohmann::json data = nlohmann::json::parse(fIn);
-        fIn.close();
-        
-        for (const auto& [name,pValue] : allParams) {
-            data["params"][name] = *pValue;
-        }
-
-        std::ofstream fOut(filePath);
-        fOut << data << '\n';
-        fOut.close();
+        std::cout << ">> file saved\n";
     }
     
-    std::cout << ">> file saved\n";
-    
-    while (ScorePlayer::ScoreSynth::state[0] != ScorePlayer::ScoreSynth::State::Idle) {}
-    SDL_Delay(10 + ScorePlayer::audio_settings::PERIOD_SIZE_MS * ScorePlayer::audio_settings::NPERIODS);
+    while (ScorePlayer::synth.state != ScorePlayer::ScoreSynth::State::Idle) SDL_Delay(1); // // lets the release fade out
+    SDL_Delay(10 + (Uint32)(ScorePlayer::audioSettings.periodSizeInMilliseconds * ScorePlayer::audioSettings.nPeriods));
     ScorePlayer::uninit();
     
     doConsoleWork = false;
@@ -319,6 +696,3 @@ int main(int argv, char** args) {
     
     return 0;
 }
-
-#include "ScoreFile.cpp"
-#include "ScoreEditor.cpp"
@@ -1,5 +1,6 @@
 #include "../external/SDL2/include/SDL.h"
 #include "../external/SDL_ttf/include/SDL_ttf.h"
+#include "TextCache.hpp"
 
 int roundint(float x) {
     return (int)std::roundf(x);
@@ -13,14 +14,13 @@ void drawRectangleContour(SDL_Renderer* renderer, int x1, int y1, int x2, int y2
     SDL_RenderDrawLine(renderer, x2, y1, x1, y1);
 }
 
-void drawArrow(SDL_Renderer* renderer, float x1, float y1, float x2, float y2) {
-    //SDL_RenderDrawLineF(renderer, x1, y1, x2, y2);
+// // arrow as a single polyline: tip, end, other tip, end, start. Returns the number of points written to points[5]
+int getArrowPolyline(SDL_Point* points, float x1, float y1, float x2, float y2) {
     int a1 = (int)std::roundf(x1);
     int b1 = (int)std::roundf(y1);
     int a2 = (int)std::roundf(x2);
     int b2 = (int)std::roundf(y2);
-    if (a1 == a2 && b1 == b2) return;
-    SDL_RenderDrawLine(renderer, a1, b1, a2, b2);
+    if (a1 == a2 && b1 == b2) return 0;
     float u = x1 - x2, v = y1 - y2;
     float tipMagnitude = 10.f;
     float factor = tipMagnitude / std::sqrt(u*u + v*v);
@@ -32,26 +32,28 @@ void drawArrow(SDL_Renderer* renderer, float x1, float y1, float x2, float y2) {
     
     float r1 = c*u + s*v, s1 = -s*u + c*v;
     float r2 = c*u - s*v, s2 = s*u + c*v;
-    //SDL_RenderDrawLineF(renderer, x2, y2, x2+r1, y2+s1);
-    //SDL_RenderDrawLineF(renderer, x2, y2, x2+r2, y2+s2);
-    SDL_RenderDrawLine(renderer, (int)std::roundf(x2), (int)std::roundf(y2), (int)std::roundf(x2+r1), (int)std::roundf(y2+s1));
-    SDL_RenderDrawLine(renderer, (int)std::roundf(x2), (int)std::roundf(y2), (int)std::roundf(x2+r2), (int)std::roundf(y2+s2));
+    points[0] = {(int)std::roundf(x2+r1), (int)std::roundf(y2+s1)};
+    points[1] = {a2, b2};
+    points[2] = {(int)std::roundf(x2+r2), (int)std::roundf(y2+s2)};
+    points[3] = {a2, b2};
+    points[4] = {a1, b1};
+    return 5;
 }
 
-void renderTextCentered(SDL_Renderer* renderer, TTF_Font* font, const char* text, SDL_Rect rect) { // // GPT-generated
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text, (SDL_Color){255, 255, 255, 255});
-    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
-    
-    int textWidth, textHeight;
-    SDL_QueryTexture(texture, NULL, NULL, &textWidth, &textHeight);
+void drawArrow(SDL_Renderer* renderer, float x1, float y1, float x2, float y2) {
+    SDL_Point points[5];
+    int nPoints = getArrowPolyline(points, x1, y1, x2, y2);
+    if (nPoints > 0) SDL_RenderDrawLines(renderer, points, nPoints);
+}
 
-    int centerX = rect.x + (rect.w - textWidth) / 2;
-    int centerY = rect.y + (rect.h - textHeight) / 2;
+void renderTextCentered(SDL_Renderer* renderer, TextCache& textCache, TTF_Font* font, const char* text, SDL_Rect rect) { // // GPT-generated
+    const TextCache::Entry* label = textCache.get(renderer, font, text, SDL_Color{255, 255, 255, 255});
+    if (!label) return;
 
-    SDL_Rect textRect = { centerX, centerY, textWidth, textHeight };
+    int centerX = rect.x + (rect.w - label->width) / 2;
+    int centerY = rect.y + (rect.h - label->height) / 2;
 
-    SDL_RenderCopy(renderer, texture, NULL, &textRect);
+    SDL_Rect textRect = { centerX, centerY, label->width, label->height };
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    SDL_RenderCopy(renderer, label->texture, NULL, &textRect);
 }
\ No newline at end of file